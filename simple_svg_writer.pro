@@ -7,7 +7,14 @@ SOURCES += \
         src/main.cpp
         
 HEADERS += \
-        src/simple_svg_writer.h
+        src/simple_svg_writer.h \
+        src/simple_svg_batch.h \
+        src/simple_svg_reader.h \
+        src/simple_svg_template.h \
+        src/simple_svg_raster.h \
+        src/simple_svg_density.h \
+        src/simple_svg_binary.h \
+        src/simple_svg_animation.h
 
 OTHER_FILES += \
     README.md
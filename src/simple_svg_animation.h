@@ -0,0 +1,344 @@
+#pragma once
+#include "simple_svg_writer.h"
+#include <map>
+#include <optional>
+#include <unordered_map>
+
+namespace simple_svg
+{
+
+//-----------------------------------------------------------------------------
+class Animation
+{
+    // Combines a sequence of frames into a single document with SMIL
+    // animations. Elements are matched between frames by their id; the
+    // document holds every element once, as in the frame it first appears
+    // in, and only attributes that change get an <animate> or <set> with a
+    // keyframe per run of equal values. Frames are either whole documents,
+    // or copies of the previous frame changed by Update().
+    //
+    //  simple_svg::Animation   animation(0.04);       // 25 frames per second
+    //  for (const auto &frame : frames)
+    //  {
+    //      animation.AddFrame(frame);
+    //  }
+    //  animation.Compile().Serialize(sink);
+    //
+    // Elements without an id are taken from the first frame. Elements that
+    // are missing in some frames are hidden there by animating display;
+    // ones missing in the first frame are appended to the document, in a
+    // group carrying the transform of their parents, together with the
+    // elements inside them that first appear along. SMIL cannot remove an
+    // attribute, so an attribute missing in a frame keeps the value of the
+    // frame before, or the first value it has, except for transforms.
+    // Transforms are animated as a translation, rotation, scale and skew,
+    // which cannot express transforms collapsing the x axis; those throw.
+    struct Track
+    {
+        std::shared_ptr<Base>       element;    ///< as in the first frame it appears in.
+        size_t                      first;      ///< frame it first appears in.
+        bool                        nested;     ///< inside the element of a track of the same first frame, and written with it.
+        simple_svg::Transform       parents;    ///< transform of the parents in that frame.
+        std::vector<signed char>    shown;      ///< per frame, -1 if as in the frame before.
+        std::map<std::string, std::vector<std::optional<std::string>>> values;  ///< per attribute name and frame.
+    };
+
+    double                                  duration;   ///< of a frame in seconds.
+    bool                                    repeat{true};
+    size_t                                  frames{0};
+    std::shared_ptr<Document>               base;       ///< the first frame.
+    std::vector<Track>                      tracks;
+    std::unordered_map<std::string, size_t> indices;    ///< of the track of every id.
+
+    void    Record(const std::shared_ptr<Base> &element, const simple_svg::Transform &parents, size_t outer = std::numeric_limits<size_t>::max())
+    /// Records element and its descendants in the last frame, outer being the
+    /// first frame of the track of the nearest ancestor with one.
+    {
+        const auto  *id = element->FindAttribute("id");
+        if (id != nullptr)
+        {
+            const auto  inserted = indices.emplace(id->Value(), tracks.size());
+            if (inserted.second)
+            {
+                tracks.push_back({element, frames - 1, outer == frames - 1, parents, std::vector<signed char>(frames, 0), {}});
+            }
+
+            Track   &track = tracks[inserted.first->second];
+            outer = track.first;
+            track.shown.back() = 1;
+            // Transform() drops identities, a missing transform is one.
+            Value(track, "transform") = std::string();
+            const auto  *fixed = dynamic_cast<const FixedBase*>(element.get());
+            const auto  expanded = fixed != nullptr ? fixed->Expand() : element;
+            for (const auto &attribute : expanded->Attributes())
+            {
+                if (attribute.Name() != "id")
+                {
+                    Value(track, attribute.Name()) = attribute.Value();
+                }
+            }
+        }
+
+        const auto  *group = dynamic_cast<const GroupBase*>(element.get());
+        if (group != nullptr)
+        {
+            const simple_svg::Transform transform = parents * element->GetTransform();
+            for (const auto &object : group->Objects())
+            {
+                Record(object, transform, outer);
+            }
+        }
+    }
+
+    std::optional<std::string>&  Value(Track &track, const std::string &name)
+    /// The value of the attribute called name in the last frame.
+    {
+        auto    &values = track.values[name];
+        values.resize(frames);
+        return values.back();
+    }
+
+    std::vector<std::pair<size_t, std::string>> Runs(std::vector<std::optional<std::string>> values) const
+    /// Frames starting a run of equal values and the values, with missing
+    /// values taken from the frame before.
+    {
+        values.resize(frames);
+        const auto  first = std::find_if(values.begin(), values.end(), [](const auto &value){return value.has_value();});
+        std::vector<std::pair<size_t, std::string>> runs;
+        if (first == values.end())
+        {
+            return runs;
+        }
+
+        runs.emplace_back(0, **first);
+        for (size_t frame = 1; frame < frames; ++frame)
+        {
+            if (values[frame] && *values[frame] != runs.back().second)
+            {
+                runs.emplace_back(frame, *values[frame]);
+            }
+        }
+        return runs;
+    }
+
+    static std::vector<std::pair<std::string, std::vector<std::pair<size_t, std::string>>>>   Decompose(const std::vector<std::pair<size_t, std::string>> &runs)
+    /// Splits transform lists into the values of <animateTransform> of the
+    /// types translate, rotate, scale and skewX, which applied in this order
+    /// give the lists, leaving out the types that are identities throughout.
+    {
+        std::vector<std::pair<std::string, std::vector<std::pair<size_t, std::string>>>>  types{{"translate", {}}, {"rotate", {}}, {"scale", {}}, {"skewX", {}}};
+        bool    used[4] = {true, false, false, false};
+        for (const auto &run : runs)
+        {
+            const simple_svg::Transform transform = simple_svg::Transform::Parse(run.second);
+            const double    scale_x = std::hypot(transform.A(), transform.B());
+            if (scale_x == 0.0)
+            {
+                throw std::invalid_argument("simple_svg::Animation: cannot animate the transform " + run.second);
+            }
+            const double    rotation = transform.Rotation();
+            const double    scale_y = transform.Determinant() / scale_x;
+            const double    skew = std::atan((transform.A() * transform.C() + transform.B() * transform.D()) / (scale_x * scale_x)) * 180.0 / std::acos(-1.0);
+
+            types[0].second.emplace_back(run.first, to_string(transform.E()) + ' ' + to_string(transform.F()));
+            types[1].second.emplace_back(run.first, to_string(rotation));
+            types[2].second.emplace_back(run.first, to_string(scale_x) + ' ' + to_string(scale_y));
+            types[3].second.emplace_back(run.first, to_string(skew));
+            used[1] = used[1] || rotation != 0.0;
+            used[2] = used[2] || scale_x != 1.0 || scale_y != 1.0;
+            used[3] = used[3] || skew != 0.0;
+        }
+
+        std::vector<std::pair<std::string, std::vector<std::pair<size_t, std::string>>>>  decomposed;
+        for (size_t i = 0; i < types.size(); ++i)
+        {
+            if (used[i])
+            {
+                decomposed.push_back(std::move(types[i]));
+            }
+        }
+        return decomposed;
+    }
+
+    void    Animate(Document &document, const std::string &id, const std::string &name, const std::vector<std::pair<size_t, std::string>> &runs) const
+    {
+        if (runs.size() < 2)
+        {
+            return;
+        }
+        if (name != "transform")
+        {
+            Keyframes(document, "animate", {{"xlink:href", "#" + id}, {"attributeName", name}}, runs);
+            return;
+        }
+
+        // browsers animate the transform attribute with <animateTransform>
+        // only, which has no matrix type. The first type replaces the
+        // transform of the element, the others are multiplied onto it.
+        for (const auto &type : Decompose(runs))
+        {
+            std::vector<Attribute>  attributes{{"xlink:href", "#" + id}, {"attributeName", name}, {"type", type.first, false}};
+            if (type.first != "translate")
+            {
+                attributes.push_back({"additive", std::string("sum"), false});
+            }
+            Keyframes(document, "animateTransform", std::move(attributes), type.second);
+        }
+    }
+
+    void    Keyframes(Document &document, const std::string &tag, std::vector<Attribute> attributes, const std::vector<std::pair<size_t, std::string>> &runs) const
+    /// Appends the keyframes of runs to document, as one tag with attributes
+    /// or a <set> per change.
+    {
+        const bool  listable = std::none_of(runs.begin(), runs.end(), [](const auto &run){return run.second.find(';') != std::string::npos;});
+        if (!listable || (!repeat && runs.size() == 2))
+        {
+            // a <set> per change, as values with ';' do not fit a value
+            // list, not repeated then.
+            for (size_t i = 1; i < runs.size(); ++i)
+            {
+                auto    set = attributes;
+                set.push_back(tag == "animate" ? Attribute("to", runs[i].second) : Attribute("values", runs[i].second));
+                set.push_back({"begin", to_string(runs[i].first * duration) + "s", false});
+                set.push_back({"fill", std::string("freeze"), false});
+                document.Append(Base(tag == "animate" ? "set" : tag, set));
+            }
+            return;
+        }
+
+        std::string values;
+        std::string key_times;
+        for (const auto &run : runs)
+        {
+            values += (values.empty() ? "" : ";") + run.second;
+            key_times += (key_times.empty() ? "" : ";") + to_string(static_cast<double>(run.first) / frames);
+        }
+        attributes.push_back({"calcMode", std::string("discrete"), false});
+        attributes.push_back({"values", values});
+        attributes.push_back({"keyTimes", key_times, false});
+        attributes.push_back({"dur", to_string(frames * duration) + "s", false});
+        attributes.push_back(repeat ? Attribute("repeatCount", std::string("indefinite"), false) : Attribute("fill", std::string("freeze"), false));
+        document.Append(Base(tag, attributes));
+    }
+
+public:
+    explicit Animation(double frame_duration = 1.0 / 25.0)
+        : duration(frame_duration)
+    {}
+
+    Animation&  Repeat(bool repeat)
+    /// Whether the animation loops, true by default, or stops at the last frame.
+    {
+        this->repeat = repeat;
+        return *this;
+    }
+
+    size_t  Frames() const {return frames;}
+
+    Animation&  AddFrame(const Document &frame)
+    {
+        ++frames;
+        for (auto &track : tracks)
+        {
+            track.shown.push_back(0);
+        }
+
+        const auto  document = std::make_shared<Document>(frame);
+        if (!base)
+        {
+            base = document;
+        }
+        for (const auto &object : document->Objects())
+        {
+            Record(object, document->GetTransform());
+        }
+        return *this;
+    }
+
+    Animation&  AddFrame()
+    /// Adds a copy of the last frame, to be changed by Update().
+    {
+        if (frames == 0)
+        {
+            throw std::logic_error("simple_svg::Animation: no frame to copy");
+        }
+        ++frames;
+        for (auto &track : tracks)
+        {
+            track.shown.push_back(-1);
+        }
+        return *this;
+    }
+
+    Animation&  Update(const std::string &id, const Attribute &attribute)
+    /// Changes an attribute of the element with id in the last frame.
+    {
+        const auto  ii = indices.find(id);
+        if (ii == indices.end())
+        {
+            throw std::out_of_range("simple_svg::Animation: no element " + id);
+        }
+        Value(tracks[ii->second], attribute.Name()) = attribute.Value();
+        return *this;
+    }
+
+    Animation&  Show(const std::string &id, bool shown)
+    /// Shows or hides the element with id from the last frame on.
+    {
+        const auto  ii = indices.find(id);
+        if (ii == indices.end())
+        {
+            throw std::out_of_range("simple_svg::Animation: no element " + id);
+        }
+        tracks[ii->second].shown.back() = shown ? 1 : 0;
+        return *this;
+    }
+
+    Document    Compile() const
+    {
+        if (!base)
+        {
+            throw std::logic_error("simple_svg::Animation: no frames");
+        }
+
+        Document    document(*base);
+        for (const auto &track : tracks)
+        {
+            const std::string   id = track.element->FindAttribute("id")->Value();
+
+            std::vector<std::optional<std::string>> shown(frames);
+            // nested elements are hidden with their ancestor before.
+            for (size_t frame = track.nested ? track.first : 0; frame < frames; ++frame)
+            {
+                if (track.shown[frame] >= 0)
+                {
+                    shown[frame] = track.shown[frame] != 0 ? "inline" : "none";
+                }
+            }
+
+            if (track.first == 0 || track.nested)
+            {
+                Animate(document, id, "display", Runs(shown));
+            }
+            else
+            {
+                // hidden in the first frame, which the element attributes
+                // cannot say without changing the element.
+                Group   group;
+                group.Id(id + "-shown").AddAttribute({"display", std::string("none"), false});
+                group.Transform(track.parents);
+                group.AppendShared(track.element);
+                document.Append(group);
+                Animate(document, id + "-shown", "display", Runs(shown));
+            }
+
+            for (const auto &value : track.values)
+            {
+                Animate(document, id, value.first, Runs(value.second));
+            }
+        }
+        return document;
+    }
+};
+
+} // namespace simple_svg
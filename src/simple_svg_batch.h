@@ -0,0 +1,195 @@
+#pragma once
+#include "simple_svg_writer.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+namespace simple_svg
+{
+
+//-----------------------------------------------------------------------------
+class BatchRenderer
+{
+    // Renders many documents across a pool of worker threads.
+    //
+    // Every worker owns one Document, which is Reset() and handed to the next
+    // job, so the child and attribute storage is reused between jobs. Output
+    // text is rendered into buffers taken from a shared pool; a separate
+    // writer thread writes them to their files and returns them to the pool
+    // with their capacity intact. At most `queued` outputs wait for the writer
+    // at any time, which bounds the memory held by finished documents.
+    //
+    // Jobs run concurrently and must not share mutable state, see the thread
+    // safety notes in README.md.
+public:
+    using Job = std::function<void(Document &document)>;
+
+private:
+    struct Task
+    {
+        std::string path;
+        Job         job;
+    };
+
+    struct Output
+    {
+        std::string path;
+        std::string text;
+    };
+
+    size_t              threads;
+    size_t              queued;
+    std::vector<Task>   tasks;
+
+    std::mutex                  mutex;
+    std::condition_variable     written;
+    std::condition_variable     rendered;
+    std::deque<Output>          outputs;
+    std::vector<std::string>    buffers;
+    size_t                      active{0};
+    std::exception_ptr          error;
+
+    void    Fail(std::exception_ptr exception)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error)
+        {
+            error = exception;
+        }
+        written.notify_all();
+        rendered.notify_all();
+    }
+
+    std::string TakeBuffer()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (buffers.empty())
+        {
+            return {};
+        }
+        std::string buffer = std::move(buffers.back());
+        buffers.pop_back();
+        return buffer;
+    }
+
+    void    Render(std::atomic<size_t> &next)
+    {
+        Document    document;
+        for (size_t i = next++; i < tasks.size(); i = next++)
+        {
+            try
+            {
+                document.Reset();
+                tasks[i].job(document);
+
+                // a recycled buffer keeps the capacity of an earlier output.
+                std::string text = TakeBuffer();
+                text.clear();
+                StringSink  sink(text);
+                document.Serialize(sink);
+
+                std::unique_lock<std::mutex> lock(mutex);
+                written.wait(lock, [this]{return outputs.size() < queued || error;});
+                if (error)
+                {
+                    return;
+                }
+                outputs.push_back({tasks[i].path, std::move(text)});
+                rendered.notify_one();
+            }
+            catch (...)
+            {
+                Fail(std::current_exception());
+                return;
+            }
+        }
+    }
+
+    void    Write()
+    {
+        for (;;)
+        {
+            Output  output;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                rendered.wait(lock, [this]{return !outputs.empty() || active == 0 || error;});
+                if (outputs.empty() || error)
+                {
+                    return;
+                }
+                output = std::move(outputs.front());
+                outputs.pop_front();
+                written.notify_one();
+            }
+
+            std::ofstream   file(output.path, std::ios::binary);
+            file.write(output.text.data(), static_cast<std::streamsize>(output.text.size()));
+            if (!file)
+            {
+                Fail(std::make_exception_ptr(std::runtime_error("simple_svg::BatchRenderer: cannot write " + output.path)));
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            buffers.push_back(std::move(output.text));
+        }
+    }
+
+public:
+    BatchRenderer(const BatchRenderer&) = delete;
+    BatchRenderer& operator=(const BatchRenderer&) = delete;
+
+    BatchRenderer(size_t threads = std::thread::hardware_concurrency(), size_t queued = 0)
+        : threads(std::max<size_t>(threads, 1)),
+          queued(queued != 0 ? queued : 2 * std::max<size_t>(threads, 1))
+    {}
+
+    BatchRenderer&  Add(const std::string &path, Job job)
+    /// Adds a job that builds the document to be written to path. The job
+    /// receives a Document in its default constructed state.
+    {
+        tasks.push_back({path, std::move(job)});
+        return *this;
+    }
+
+    void    Run()
+    /// Runs all added jobs and returns once every output is written. The
+    /// first exception thrown by a job or the writer is rethrown here.
+    {
+        std::atomic<size_t> next{0};
+        error = nullptr;
+        active = threads;
+
+        std::thread                 writer(&BatchRenderer::Write, this);
+        std::vector<std::thread>    workers;
+        for (size_t i = 0; i < threads; ++i)
+        {
+            workers.emplace_back([this, &next]
+            {
+                Render(next);
+
+                std::lock_guard<std::mutex> lock(mutex);
+                --active;
+                rendered.notify_one();
+            });
+        }
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+        writer.join();
+
+        tasks.clear();
+        outputs.clear();
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+} // namespace simple_svg
@@ -0,0 +1,606 @@
+#pragma once
+#include "simple_svg_reader.h"
+#include "simple_svg_template.h"
+#include <deque>
+#include <fstream>
+#include <string_view>
+#include <typeinfo>
+#include <unordered_map>
+
+namespace simple_svg
+{
+
+//-----------------------------------------------------------------------------
+class Binary
+{
+    // Compact binary form of an element tree for caching documents between
+    // runs or passing them to another process, much faster to read back than
+    // SVG text. Tags, attribute names and values and text are stored once in
+    // a string table; coordinates are stored as raw arrays in their storage
+    // representation and read back with a single copy each. Images embedded
+    // from a file keep referring to the file. Fixed elements are stored as
+    // the attribute based element they write the same as; elements of
+    // classes defined outside the library cannot be written.
+    //
+    //  simple_svg::Binary::WriteFile(document, "cache.ssvg");
+    //  ...
+    //  const auto  root = simple_svg::Binary::ReadFile("cache.ssvg");
+    //  root->Serialize(sink);
+    //
+    // Layout, in native byte order, rejected on reading by a machine of
+    // another byte order:
+    //
+    //  "SSVG" u32 version u32 0x01020304
+    //  u32 string count, per string: u32 size, bytes
+    //  the root element: u8 kind u32 tag u32 attribute count,
+    //      per attribute: u32 name u32 value u8 escape,
+    //      followed by the data of the kind, e.g. the children of groups.
+    //
+    // Reading stops at elements nested deeper than max_depth, which a
+    // corrupt or hostile file would otherwise use to overflow the stack.
+    static constexpr uint32_t   version{2};
+    static constexpr uint32_t   byte_order{0x01020304};
+    static constexpr size_t     max_depth{256};
+
+    enum class Kind : uint8_t
+    {
+        Markup,         ///< u32 text, read back as unescaped CharacterData, written by version 1 only.
+        Base,
+        Rect,
+        Line,
+        Circle,
+        Ellipse,
+        Use,
+        Polyline,       ///< coordinates.
+        Polygon,        ///< coordinates.
+        Path,           ///< u64 command count, commands, coordinates.
+        MarkerBatch,    ///< marker path element, f64 width, f64 height, u32 marker id, positions, sizes.
+        Text,           ///< u32 content, u8 escape, children.
+        CharacterData,  ///< u32 content, u8 escape.
+        Element,        ///< children.
+        Group,          ///< children.
+        Layer,          ///< children.
+        Document,       ///< children.
+        Image,          ///< u8 source, u32 location, u32 mime, u64 size, bytes of a buffer.
+        LevelOfDetail,  ///< u64 level count, f64 scales, u64 selected, u64 width count, i64 pairs of widths, children.
+        Slot,           ///< u32 name.
+        CircleBatch,    ///< as MarkerBatch.
+        RectBatch       ///< as MarkerBatch.
+    };
+
+    //-------------------------------------------------------------------------
+    class Encoder
+    {
+        std::deque<std::string>                         strings;    ///< stable for the views in indices.
+        std::unordered_map<std::string_view, uint32_t>  indices;
+        std::string                                     records;
+
+        template<typename T>
+        void    Put(T value)
+        {
+            records.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        void    PutString(const std::string &text)
+        {
+            const auto  ii = indices.find(text);
+            if (ii != indices.end())
+            {
+                Put<uint32_t>(ii->second);
+                return;
+            }
+            const uint32_t  index = static_cast<uint32_t>(strings.size());
+            strings.push_back(text);
+            indices.emplace(strings.back(), index);
+            Put<uint32_t>(index);
+        }
+
+        void    PutCoordinates(const Coordinates &coordinates)
+        {
+            Put<uint8_t>(static_cast<uint8_t>(coordinates.Kind()));
+            Put<uint8_t>(static_cast<uint8_t>(coordinates.Decimals()));
+            Put<uint64_t>(coordinates.Size());
+            records.append(static_cast<const char*>(coordinates.Data()), coordinates.Size() * coordinates.ValueBytes());
+        }
+
+        void    PutChildren(const GroupBase &group, size_t depth)
+        {
+            Put<uint64_t>(group.Objects().size());
+            for (const auto &object : group.Objects())
+            {
+                PutElement(*object, depth + 1);
+            }
+        }
+
+        static Kind KindOf(const simple_svg::Base &element)
+        {
+            const std::type_info    &type = typeid(element);
+            if (type == typeid(simple_svg::Base))           return Kind::Base;
+            if (type == typeid(simple_svg::Rect))           return Kind::Rect;
+            if (type == typeid(simple_svg::Line))           return Kind::Line;
+            if (type == typeid(simple_svg::Circle))         return Kind::Circle;
+            if (type == typeid(simple_svg::Ellipse))        return Kind::Ellipse;
+            if (type == typeid(simple_svg::Use))            return Kind::Use;
+            if (type == typeid(simple_svg::Polyline))       return Kind::Polyline;
+            if (type == typeid(simple_svg::Polygon))        return Kind::Polygon;
+            if (type == typeid(simple_svg::Path))           return Kind::Path;
+            if (type == typeid(simple_svg::Text))           return Kind::Text;
+            if (type == typeid(simple_svg::CharacterData))  return Kind::CharacterData;
+            if (type == typeid(simple_svg::Element))        return Kind::Element;
+            if (type == typeid(simple_svg::Group))          return Kind::Group;
+            if (type == typeid(simple_svg::Layer))          return Kind::Layer;
+            if (type == typeid(simple_svg::Document))       return Kind::Document;
+            if (type == typeid(simple_svg::Image))          return Kind::Image;
+            if (type == typeid(simple_svg::MarkerBatch))    return Kind::MarkerBatch;
+            if (type == typeid(simple_svg::LevelOfDetail))  return Kind::LevelOfDetail;
+            if (type == typeid(simple_svg::Slot))           return Kind::Slot;
+            if (type == typeid(simple_svg::CircleBatch))    return Kind::CircleBatch;
+            if (type == typeid(simple_svg::RectBatch))      return Kind::RectBatch;
+            // read back as another class, or not at all, writing nothing is better.
+            throw std::invalid_argument(std::string("simple_svg::Binary: cannot write elements of class ") + type.name());
+        }
+
+    public:
+        void    PutElement(const simple_svg::Base &element, size_t depth = 0)
+        {
+            if (depth > max_depth)
+            {
+                throw std::invalid_argument("simple_svg::Binary: elements nested too deep");
+            }
+            if (auto fixed = dynamic_cast<const FixedBase*>(&element))
+            {
+                // read back as the element it writes the same as.
+                PutElement(*fixed->Expand(), depth);
+                return;
+            }
+            const Kind  kind = KindOf(element);
+            Put<uint8_t>(static_cast<uint8_t>(kind));
+
+            PutString(element.Tag());
+            const auto  &attributes = element.Attributes();
+            Put<uint32_t>(static_cast<uint32_t>(attributes.size()));
+            for (const auto &attribute : attributes)
+            {
+                PutString(attribute.Name());
+                PutString(attribute.Value());
+                Put<uint8_t>(attribute.Escape());
+            }
+
+            switch (kind)
+            {
+            case Kind::Polyline:
+            case Kind::Polygon:
+                PutCoordinates(static_cast<const PolyBase&>(element).Values());
+                break;
+            case Kind::Path:
+            {
+                const auto  &path = static_cast<const simple_svg::Path&>(element);
+                Put<uint64_t>(path.Commands().size());
+                records.append(path.Commands().data(), path.Commands().size());
+                PutCoordinates(path.Arguments());
+                break;
+            }
+            case Kind::MarkerBatch:
+            case Kind::CircleBatch:
+            case Kind::RectBatch:
+            {
+                const auto  &batch = static_cast<const simple_svg::MarkerBatch&>(element);
+                PutElement(batch.Marker(), depth + 1);
+                Put<double>(batch.DefaultWidth());
+                Put<double>(batch.DefaultHeight());
+                PutString(batch.MarkerId());
+                PutCoordinates(batch.Positions());
+                PutCoordinates(batch.Sizes());
+                break;
+            }
+            case Kind::Text:
+            {
+                const auto  &text = static_cast<const simple_svg::Text&>(element);
+                PutString(text.Content());
+                Put<uint8_t>(text.Escape());
+                PutChildren(text, depth);
+                break;
+            }
+            case Kind::CharacterData:
+            {
+                const auto  &data = static_cast<const simple_svg::CharacterData&>(element);
+                PutString(data.Content());
+                Put<uint8_t>(data.Escape());
+                break;
+            }
+            case Kind::Element:
+            case Kind::Group:
+            case Kind::Layer:
+            case Kind::Document:
+                PutChildren(static_cast<const GroupBase&>(element), depth);
+                break;
+            case Kind::LevelOfDetail:
+            {
+                const auto  &detail = static_cast<const simple_svg::LevelOfDetail&>(element);
+                Put<uint64_t>(detail.Scales().size());
+                records.append(reinterpret_cast<const char*>(detail.Scales().data()), detail.Scales().size() * sizeof(double));
+                Put<uint64_t>(detail.Selected());
+                Put<uint64_t>(detail.Widths().size());
+                for (const auto &range : detail.Widths())
+                {
+                    Put<int64_t>(range.first);
+                    Put<int64_t>(range.second);
+                }
+                PutChildren(detail, depth);
+                break;
+            }
+            case Kind::Slot:
+                PutString(static_cast<const simple_svg::Slot&>(element).Name());
+                break;
+            case Kind::Image:
+            {
+                const auto  &image = static_cast<const simple_svg::Image&>(element);
+                Put<uint8_t>(static_cast<uint8_t>(image.Kind()));
+                PutString(image.Location());
+                PutString(image.Mime());
+                Put<uint64_t>(image.Size());
+                records.append(reinterpret_cast<const char*>(image.Bytes()), image.Size());
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        void    Finish(Sink &sink) const
+        {
+            sink.Write("SSVG", 4);
+            const uint32_t  header[3] = {version, byte_order, static_cast<uint32_t>(strings.size())};
+            sink.Write(reinterpret_cast<const char*>(header), sizeof(header));
+            for (const auto &text : strings)
+            {
+                const uint32_t  size = static_cast<uint32_t>(text.size());
+                sink.Write(reinterpret_cast<const char*>(&size), sizeof(size));
+                sink.Write(text.data(), text.size());
+            }
+            sink.Write(records.data(), records.size());
+        }
+    };
+
+    //-------------------------------------------------------------------------
+    class Decoder
+    {
+        const char                      *data;
+        const char                      *end;
+        std::vector<std::string_view>   strings;
+
+        void    Need(size_t size) const
+        {
+            if (size > static_cast<size_t>(end - data))
+            {
+                throw std::runtime_error("simple_svg::Binary: truncated data");
+            }
+        }
+
+        template<typename T>
+        T       Get()
+        {
+            Need(sizeof(T));
+            T   value;
+            std::memcpy(&value, data, sizeof(T));
+            data += sizeof(T);
+            return value;
+        }
+
+        std::string GetString()
+        {
+            const uint32_t  index = Get<uint32_t>();
+            if (index >= strings.size())
+            {
+                throw std::runtime_error("simple_svg::Binary: bad string index");
+            }
+            return std::string(strings[index]);
+        }
+
+        Coordinates GetCoordinates()
+        {
+            const uint8_t   storage = Get<uint8_t>();
+            const uint8_t   decimals = Get<uint8_t>();
+            const uint64_t  count = Get<uint64_t>();
+            if (storage > static_cast<uint8_t>(Storage::Exact) || decimals > 9)
+            {
+                throw std::runtime_error("simple_svg::Binary: bad coordinate storage");
+            }
+
+            const size_t    bytes = static_cast<Storage>(storage) == Storage::Double || static_cast<Storage>(storage) == Storage::Exact ? sizeof(double) : 4;
+            if (count > static_cast<uint64_t>(end - data) / bytes)
+            {
+                throw std::runtime_error("simple_svg::Binary: truncated data");
+            }
+            Coordinates coordinates;
+            coordinates.Assign(static_cast<Storage>(storage), decimals, data, static_cast<size_t>(count));
+            data += count * bytes;
+            return coordinates;
+        }
+
+        void    GetChildren(GroupBase &group, size_t depth)
+        {
+            const uint64_t  count = Get<uint64_t>();
+            for (uint64_t i = 0; i < count; ++i)
+            {
+                group.AppendShared(GetElement(depth + 1));
+            }
+        }
+
+        template<typename T>
+        std::shared_ptr<T>  Fill(std::shared_ptr<T> element, const std::vector<Attribute> &attributes)
+        {
+            element->ClearAttributes();
+            for (const auto &attribute : attributes)
+            {
+                element->AddAttribute(attribute);
+            }
+            return element;
+        }
+
+    public:
+        explicit Decoder(std::string_view binary)
+            : data(binary.data()),
+              end(binary.data() + binary.size())
+        {
+            Need(4);
+            if (std::memcmp(data, "SSVG", 4) != 0)
+            {
+                throw std::runtime_error("simple_svg::Binary: not a binary document");
+            }
+            data += 4;
+            const uint32_t  written = Get<uint32_t>();
+            if (written < 1 || written > version)
+            {
+                throw std::runtime_error("simple_svg::Binary: unsupported version");
+            }
+            if (Get<uint32_t>() != byte_order)
+            {
+                throw std::runtime_error("simple_svg::Binary: written with another byte order");
+            }
+
+            const uint32_t  count = Get<uint32_t>();
+            strings.reserve(std::min<size_t>(count, static_cast<size_t>(end - data) / 4));
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const uint32_t  size = Get<uint32_t>();
+                Need(size);
+                strings.emplace_back(data, size);
+                data += size;
+            }
+        }
+
+        std::shared_ptr<simple_svg::Base>   GetElement(size_t depth = 0)
+        {
+            if (depth > max_depth)
+            {
+                throw std::runtime_error("simple_svg::Binary: elements nested too deep");
+            }
+            const Kind  kind = static_cast<Kind>(Get<uint8_t>());
+            if (kind > Kind::RectBatch)
+            {
+                throw std::runtime_error("simple_svg::Binary: unknown element kind");
+            }
+            if (kind == Kind::Markup)
+            {
+                return std::make_shared<simple_svg::CharacterData>(GetString(), false);
+            }
+
+            const std::string   tag = GetString();
+            const uint32_t      count = Get<uint32_t>();
+            std::vector<Attribute>  attributes;
+            attributes.reserve(std::min<size_t>(count, static_cast<size_t>(end - data) / 9));
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                std::string name = GetString();
+                std::string value = GetString();
+                attributes.emplace_back(std::move(name), std::move(value), Get<uint8_t>() != 0);
+            }
+
+            switch (kind)
+            {
+            case Kind::Rect:    return Fill(std::make_shared<simple_svg::Rect>(), attributes);
+            case Kind::Line:    return Fill(std::make_shared<simple_svg::Line>(), attributes);
+            case Kind::Circle:  return Fill(std::make_shared<simple_svg::Circle>(), attributes);
+            case Kind::Ellipse: return Fill(std::make_shared<simple_svg::Ellipse>(), attributes);
+            case Kind::Use:     return Fill(std::make_shared<simple_svg::Use>(), attributes);
+            case Kind::Polyline:
+            {
+                auto    polyline = Fill(std::make_shared<simple_svg::Polyline>(), attributes);
+                polyline->Assign(GetCoordinates());
+                return polyline;
+            }
+            case Kind::Polygon:
+            {
+                auto    polygon = Fill(std::make_shared<simple_svg::Polygon>(), attributes);
+                polygon->Assign(GetCoordinates());
+                return polygon;
+            }
+            case Kind::Path:
+            {
+                const uint64_t  size = Get<uint64_t>();
+                Need(size);
+                std::vector<char>   commands(data, data + size);
+                data += size;
+                auto    path = Fill(std::make_shared<simple_svg::Path>(), attributes);
+                path->Assign(std::move(commands), GetCoordinates());
+                return path;
+            }
+            case Kind::MarkerBatch:
+            case Kind::CircleBatch:
+            case Kind::RectBatch:
+            {
+                const auto  marker = std::dynamic_pointer_cast<simple_svg::Path>(GetElement(depth + 1));
+                if (!marker)
+                {
+                    throw std::runtime_error("simple_svg::Binary: marker is not a path");
+                }
+                const double    width = Get<double>();
+                const double    height = Get<double>();
+                std::shared_ptr<simple_svg::MarkerBatch>    batch;
+                if (kind == Kind::CircleBatch)
+                {
+                    batch = std::make_shared<simple_svg::CircleBatch>(width);
+                }
+                else if (kind == Kind::RectBatch)
+                {
+                    batch = std::make_shared<simple_svg::RectBatch>(width, height);
+                }
+                else
+                {
+                    batch = std::make_shared<simple_svg::MarkerBatch>(*marker, width, height);
+                }
+                Fill(batch, attributes);
+                batch->UseMarker(GetString());
+                Coordinates     positions = GetCoordinates();
+                batch->Assign(std::move(positions), GetCoordinates());
+                return batch;
+            }
+            case Kind::Text:
+            {
+                auto    text = Fill(std::make_shared<simple_svg::Text>(0, 0, GetString()), attributes);
+                text->Escape(Get<uint8_t>() != 0);
+                GetChildren(*text, depth);
+                return text;
+            }
+            case Kind::CharacterData:
+            {
+                std::string content = GetString();
+                return std::make_shared<simple_svg::CharacterData>(std::move(content), Get<uint8_t>() != 0);
+            }
+            case Kind::Element:
+            {
+                auto    element = std::make_shared<simple_svg::Element>(tag, attributes);
+                GetChildren(*element, depth);
+                return element;
+            }
+            case Kind::Group:
+            case Kind::Layer:
+            case Kind::Document:
+            {
+                std::shared_ptr<GroupBase>  group;
+                if (kind == Kind::Group)
+                {
+                    group = std::make_shared<simple_svg::Group>();
+                }
+                else if (kind == Kind::Layer)
+                {
+                    group = std::make_shared<simple_svg::Layer>();
+                }
+                else
+                {
+                    group = std::make_shared<simple_svg::Document>();
+                }
+                Fill(group, attributes);
+                GetChildren(*group, depth);
+                return group;
+            }
+            case Kind::Image:
+            {
+                auto            image = Fill(std::make_shared<simple_svg::Image>(), attributes);
+                const uint8_t   source = Get<uint8_t>();
+                std::string     location = GetString();
+                std::string     mime = GetString();
+                const uint64_t  size = Get<uint64_t>();
+                Need(size);
+                if (source == static_cast<uint8_t>(simple_svg::Image::Source::File))
+                {
+                    image->File(location, mime);
+                }
+                else if (source == static_cast<uint8_t>(simple_svg::Image::Source::Buffer))
+                {
+                    image->Data(std::vector<uint8_t>(data, data + size), mime);
+                }
+                else
+                {
+                    image->Link(location);
+                }
+                data += size;
+                return image;
+            }
+            case Kind::LevelOfDetail:
+            {
+                const uint64_t  count = Get<uint64_t>();
+                if (count > static_cast<uint64_t>(end - data) / sizeof(double))
+                {
+                    throw std::runtime_error("simple_svg::Binary: truncated data");
+                }
+                std::vector<double> scales(static_cast<size_t>(count));
+                std::memcpy(scales.data(), data, scales.size() * sizeof(double));
+                data += scales.size() * sizeof(double);
+                const uint64_t  selected = Get<uint64_t>();
+                const uint64_t  ranges = Get<uint64_t>();
+                if (ranges > static_cast<uint64_t>(end - data) / (2 * sizeof(int64_t)))
+                {
+                    throw std::runtime_error("simple_svg::Binary: truncated data");
+                }
+                std::vector<std::pair<long, long>>  widths;
+                widths.reserve(static_cast<size_t>(ranges));
+                for (uint64_t i = 0; i < ranges; ++i)
+                {
+                    const int64_t   from = Get<int64_t>();
+                    widths.emplace_back(static_cast<long>(from), static_cast<long>(Get<int64_t>()));
+                }
+                auto    detail = Fill(std::make_shared<simple_svg::LevelOfDetail>(), attributes);
+                GetChildren(*detail, depth);
+                detail->Assign(std::move(scales), static_cast<size_t>(selected), std::move(widths));
+                return detail;
+            }
+            case Kind::Slot:
+                return std::make_shared<simple_svg::Slot>(GetString());
+            default:
+                return std::make_shared<simple_svg::Base>(tag, attributes);
+            }
+        }
+
+        bool    AtEnd() const {return data == end;}
+    };
+
+public:
+    static void Write(const simple_svg::Base &root, Sink &sink)
+    {
+        Encoder encoder;
+        encoder.PutElement(root);
+        encoder.Finish(sink);
+    }
+
+    static std::string  ToBinary(const simple_svg::Base &root)
+    {
+        std::string binary;
+        StringSink  sink(binary);
+        Write(root, sink);
+        return binary;
+    }
+
+    static void WriteFile(const simple_svg::Base &root, const std::string &path)
+    {
+        std::ofstream   file(path, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("simple_svg::Binary: cannot open " + path);
+        }
+        StreamSink  sink(file);
+        Write(root, sink);
+    }
+
+    static std::shared_ptr<simple_svg::Base>    Read(std::string_view binary)
+    /// Reads the element tree written by Write(), with the element classes
+    /// it was built from.
+    {
+        Decoder decoder(binary);
+        auto    root = decoder.GetElement();
+        if (!decoder.AtEnd())
+        {
+            throw std::runtime_error("simple_svg::Binary: trailing data");
+        }
+        return root;
+    }
+
+    static std::shared_ptr<simple_svg::Base>    ReadFile(const std::string &path)
+    {
+        MappedFile  file(path);
+        return Read(file.View());
+    }
+};
+
+} // namespace simple_svg
@@ -0,0 +1,362 @@
+#pragma once
+#include "simple_svg_writer.h"
+#include "simple_svg_raster.h"
+#include <thread>
+
+namespace simple_svg
+{
+
+//-----------------------------------------------------------------------------
+class DensityMap
+{
+    // Aggregates point sets with more points than pixels into a grid of cells
+    // and draws the cell totals through a colour ramp, either as one RectBatch
+    // per colour, with equal neighbouring cells merged, or as an embedded
+    // image of one pixel per cell.
+    //
+    // Add() bins the points in parallel: every thread counts a slice of the
+    // points into a grid of its own, and the grids are summed afterwards, row
+    // bands in parallel. Call Add() repeatedly to stream points in chunks;
+    // the extra grids are kept between calls, and a chunk only takes extra
+    // threads if it has at least twice as many points as cells, and 65536.
+public:
+    enum class Scale
+    {
+        Linear,
+        Log         ///< log(1 + total), for totals spanning many magnitudes.
+    };
+
+private:
+    double                  x0;
+    double                  y0;
+    double                  cell_width;
+    double                  cell_height;
+    size_t                  columns;
+    size_t                  rows;
+    size_t                  threads;
+    Scale                   scale{Scale::Linear};
+    size_t                  levels{64};
+    std::vector<uint32_t>   ramp{0x440154, 0x3b528b, 0x21918c, 0x5ec962, 0xfde725};
+    std::vector<double>     totals;
+    std::vector<std::vector<double>>    grids;  ///< of the threads but the first, zero between calls of Add().
+
+    std::vector<size_t> CellLevels() const
+    /// Colour level of every cell, 0 for empty cells and 1 to levels otherwise.
+    {
+        const double    maximum = *std::max_element(totals.begin(), totals.end());
+        auto            map = [this](double v){return scale == Scale::Log ? std::log1p(v) : v;};
+        const double    top = map(maximum);
+
+        std::vector<size_t> result(totals.size(), 0);
+        for (size_t i = 0; i < totals.size(); ++i)
+        {
+            if (totals[i] > 0.0 && top > 0.0)
+            {
+                result[i] = 1 + std::min(levels - 1, static_cast<size_t>(map(totals[i]) / top * static_cast<double>(levels - 1) + 0.5));
+            }
+        }
+        return result;
+    }
+
+    uint32_t    Colour(size_t level) const
+    /// Ramp colour of level 1 to levels, interpolated between the stops.
+    {
+        const double    t = levels > 1 ? static_cast<double>(level - 1) / static_cast<double>(levels - 1) * static_cast<double>(ramp.size() - 1) : 0.0;
+        const size_t    i = std::min(static_cast<size_t>(t), ramp.size() - 1);
+        const size_t    j = std::min(i + 1, ramp.size() - 1);
+        const double    f = t - static_cast<double>(i);
+        uint32_t        rgb{0};
+        for (int shift = 16; shift >= 0; shift -= 8)
+        {
+            const double    a = (ramp[i] >> shift) & 0xff;
+            const double    b = (ramp[j] >> shift) & 0xff;
+            rgb |= static_cast<uint32_t>(std::lround(a + (b - a) * f)) << shift;
+        }
+        return rgb;
+    }
+
+    static std::string  Hex(uint32_t rgb)
+    {
+        char    buffer[8];
+        std::snprintf(buffer, sizeof(buffer), "#%06x", static_cast<unsigned>(rgb));
+        return buffer;
+    }
+
+public:
+    DensityMap(double x, double y, double width, double height, size_t columns, size_t rows)
+    /// Grid of columns x rows cells covering x, y, width, height in user space.
+        : x0(x),
+          y0(y),
+          cell_width(width / static_cast<double>(std::max<size_t>(columns, 1))),
+          cell_height(height / static_cast<double>(std::max<size_t>(rows, 1))),
+          columns(std::max<size_t>(columns, 1)),
+          rows(std::max<size_t>(rows, 1)),
+          threads(std::max<size_t>(1, std::thread::hardware_concurrency())),
+          totals(this->columns * this->rows, 0.0)
+    {}
+
+    explicit DensityMap(const Document &document, double cell_size = 1.0)
+    /// Grid over the view box of document, or its width and height without
+    /// one, of cells cell_size output pixels wide and high.
+        : DensityMap(0.0, 0.0, 1.0, 1.0, 1, 1)
+    {
+        const double    width = document.NumericAttribute("width", 0.0);
+        const double    height = document.NumericAttribute("height", 0.0);
+        double          box[4]{0.0, 0.0, width, height};
+        document.GetViewBox(box);
+        if (box[2] <= 0.0 || box[3] <= 0.0)
+        {
+            throw std::invalid_argument("simple_svg::DensityMap: the document has neither a view box nor a size");
+        }
+
+        const double    pixels_x = width > 0.0 ? width : box[2];
+        const double    pixels_y = height > 0.0 ? height : box[3];
+        *this = DensityMap(box[0], box[1], box[2], box[3],
+                           static_cast<size_t>(std::ceil(pixels_x / cell_size)),
+                           static_cast<size_t>(std::ceil(pixels_y / cell_size)));
+    }
+
+    size_t  Columns() const {return columns;}
+    size_t  Rows() const {return rows;}
+    double  Total(size_t column, size_t row) const {return totals[row * columns + column];}
+
+    DensityMap& Threads(size_t threads)
+    {
+        this->threads = std::max<size_t>(1, threads);
+        return *this;
+    }
+
+    DensityMap& Ramp(const std::vector<std::string> &colours)
+    /// Colour stops from the lowest to the highest total, evenly spaced.
+    {
+        std::vector<uint32_t>   stops;
+        for (const auto &colour : colours)
+        {
+            uint32_t    rgb{0};
+            if (!parse_colour(colour, rgb))
+            {
+                throw std::invalid_argument("simple_svg::DensityMap: unknown colour " + colour);
+            }
+            stops.push_back(rgb);
+        }
+        if (stops.empty())
+        {
+            throw std::invalid_argument("simple_svg::DensityMap: empty colour ramp");
+        }
+        ramp.swap(stops);
+        return *this;
+    }
+
+    DensityMap& Levels(size_t levels)
+    /// Number of distinct colours, fewer merge more cells.
+    {
+        this->levels = std::max<size_t>(1, levels);
+        return *this;
+    }
+
+    DensityMap& Scaling(Scale scale)
+    {
+        this->scale = scale;
+        return *this;
+    }
+
+    DensityMap& Clear()
+    {
+        std::fill(totals.begin(), totals.end(), 0.0);
+        return *this;
+    }
+
+    DensityMap& Add(const double *x, const double *y, size_t count, const double *weights = nullptr)
+    /// Adds count points, weighted by weights[i] or 1. Points outside the
+    /// grid are ignored.
+    {
+        // a grid per thread, but no more threads than worth their grid.
+        const size_t    workers = std::max<size_t>(1, std::min(threads, count / std::max<size_t>(totals.size(), 65536)));
+        const size_t    slice = (count + workers - 1) / workers;
+        if (grids.size() < workers - 1)
+        {
+            grids.resize(workers - 1, std::vector<double>(totals.size(), 0.0));
+        }
+
+        auto    bin = [&](size_t worker)
+        {
+            double          *grid = worker == 0 ? totals.data() : grids[worker - 1].data();
+            const double    sx = 1.0 / cell_width;
+            const double    sy = 1.0 / cell_height;
+            const size_t    last = std::min(count, (worker + 1) * slice);
+            for (size_t i = worker * slice; i < last; ++i)
+            {
+                const double    column = (x[i] - x0) * sx;
+                const double    row = (y[i] - y0) * sy;
+                if (column >= 0.0 && row >= 0.0 && column < static_cast<double>(columns) && row < static_cast<double>(rows))
+                {
+                    grid[static_cast<size_t>(row) * columns + static_cast<size_t>(column)] += weights != nullptr ? weights[i] : 1.0;
+                }
+            }
+        };
+
+        std::vector<std::thread>    pool;
+        for (size_t worker = 1; worker < workers; ++worker)
+        {
+            pool.emplace_back(bin, worker);
+        }
+        bin(0);
+        for (auto &thread : pool)
+        {
+            thread.join();
+        }
+        pool.clear();
+
+        // sum the grids, a band of rows per thread, clearing them for the
+        // next call.
+        const size_t    band = (rows + workers - 1) / workers;
+        auto    reduce = [&](size_t worker)
+        {
+            const size_t    first = worker * band * columns;
+            const size_t    last = std::min(totals.size(), (worker + 1) * band * columns);
+            for (size_t g = 0; g + 1 < workers; ++g)
+            {
+                double  *grid = grids[g].data();
+                for (size_t i = first; i < last; ++i)
+                {
+                    totals[i] += grid[i];
+                    grid[i] = 0.0;
+                }
+            }
+        };
+        for (size_t worker = 1; worker < workers; ++worker)
+        {
+            pool.emplace_back(reduce, worker);
+        }
+        reduce(0);
+        for (auto &thread : pool)
+        {
+            thread.join();
+        }
+
+        return *this;
+    }
+
+    DensityMap& Add(const std::vector<double> &x, const std::vector<double> &y)
+    {
+        return Add(x.data(), y.data(), std::min(x.size(), y.size()));
+    }
+
+    DensityMap& Add(const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &weights)
+    {
+        return Add(x.data(), y.data(), std::min({x.size(), y.size(), weights.size()}), weights.data());
+    }
+
+    Group   Rects() const
+    /// The non empty cells as one RectBatch per colour. Cells of equal colour
+    /// are merged into runs along rows, and equal runs of consecutive rows
+    /// into a single rectangle.
+    {
+        struct Run
+        {
+            size_t  column;
+            size_t  length;
+            size_t  level;
+            size_t  row;        ///< first row.
+            size_t  height;     ///< in rows, once finished.
+        };
+
+        const auto          level = CellLevels();
+        std::vector<std::vector<Run>>   finished(levels + 1);
+        std::vector<Run>    open;
+        std::vector<Run>    current;
+        size_t  row{0};
+        auto    close = [&finished, &row](Run run)
+        {
+            run.height = row - run.row;
+            finished[run.level].push_back(run);
+        };
+
+        for (; row <= rows; ++row)
+        {
+            current.clear();
+            for (size_t column = 0; row < rows && column < columns;)
+            {
+                const size_t    l = level[row * columns + column];
+                size_t          end = column + 1;
+                while (end < columns && level[row * columns + end] == l)
+                {
+                    ++end;
+                }
+                if (l != 0)
+                {
+                    current.push_back({column, end - column, l, row, 0});
+                }
+                column = end;
+            }
+
+            // runs of the previous rows continue if this row has an equal one.
+            auto    o = open.begin();
+            for (auto &run : current)
+            {
+                while (o != open.end() && o->column < run.column)
+                {
+                    close(*o++);
+                }
+                if (o != open.end() && o->column == run.column && o->length == run.length && o->level == run.level)
+                {
+                    run.row = o->row;
+                    ++o;
+                }
+            }
+            std::for_each(o, open.end(), close);
+            open.swap(current);
+        }
+
+        Group   group;
+        group.AddAttribute({"shape-rendering", std::string("crispEdges"), false});
+        for (size_t l = 1; l <= levels; ++l)
+        {
+            if (finished[l].empty())
+            {
+                continue;
+            }
+            RectBatch   batch(cell_width, cell_height);
+            batch.Reserve(finished[l].size());
+            for (const auto &run : finished[l])
+            {
+                batch.Add(x0 + static_cast<double>(run.column) * cell_width, y0 + static_cast<double>(run.row) * cell_height,
+                          static_cast<double>(run.length) * cell_width, static_cast<double>(run.height) * cell_height);
+            }
+            batch.Fill(Hex(Colour(l)));
+            group.Append(batch);
+        }
+        return group;
+    }
+
+    std::vector<uint8_t>    Pixels() const
+    /// 8 bit RGBA pixels of the cells, empty cells transparent.
+    {
+        const auto              level = CellLevels();
+        std::vector<uint8_t>    pixels(totals.size() * 4, 0);
+        for (size_t i = 0; i < totals.size(); ++i)
+        {
+            if (level[i] != 0)
+            {
+                const uint32_t  rgb = Colour(level[i]);
+                pixels[i * 4 + 0] = static_cast<uint8_t>(rgb >> 16);
+                pixels[i * 4 + 1] = static_cast<uint8_t>(rgb >> 8);
+                pixels[i * 4 + 2] = static_cast<uint8_t>(rgb);
+                pixels[i * 4 + 3] = 255;
+            }
+        }
+        return pixels;
+    }
+
+    simple_svg::Image   Image() const
+    /// The cells as an <image> with an embedded PNG of a pixel per cell.
+    {
+        simple_svg::Image   image(x0, y0, cell_width * static_cast<double>(columns), cell_height * static_cast<double>(rows));
+        image.Data(encode_png(Pixels().data(), columns, rows), "image/png");
+        image.AddAttribute({"preserveAspectRatio", std::string("none"), false});
+        image.AddAttribute({"style", std::string("image-rendering:pixelated"), false});
+        return image;
+    }
+};
+
+} // namespace simple_svg
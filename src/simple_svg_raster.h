@@ -0,0 +1,1105 @@
+#pragma once
+#include "simple_svg_writer.h"
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+
+namespace simple_svg
+{
+
+//-----------------------------------------------------------------------------
+inline uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0)
+{
+    static const auto   table = []
+    {
+        std::array<uint32_t, 256>   t{};
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t    c = n;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            t[n] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+inline std::vector<uint8_t> deflate(const uint8_t *data, size_t size)
+/// zlib stream of data, compressed with greedy LZ77 matching and the fixed
+/// Huffman codes of deflate, which keeps the encoder small and fast.
+{
+    static const uint16_t   length_base[29] = {3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258};
+    static const uint8_t    length_extra[29] = {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0};
+    static const uint16_t   distance_base[30] = {1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577};
+    static const uint8_t    distance_extra[30] = {0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+
+    std::vector<uint8_t>    out{0x78, 0x01};
+    uint64_t                bits{0};
+    unsigned                count{0};
+    auto    put = [&](uint32_t value, unsigned length)
+    {
+        bits |= static_cast<uint64_t>(value) << count;
+        for (count += length; count >= 8; count -= 8, bits >>= 8)
+        {
+            out.push_back(static_cast<uint8_t>(bits));
+        }
+    };
+    auto    put_code = [&put](uint32_t code, unsigned length)
+    {
+        // Huffman codes are stored most significant bit first.
+        uint32_t    reversed{0};
+        for (unsigned i = 0; i < length; ++i)
+        {
+            reversed |= ((code >> i) & 1u) << (length - 1 - i);
+        }
+        put(reversed, length);
+    };
+    auto    put_symbol = [&put_code](uint32_t symbol)
+    {
+        if      (symbol < 144)  put_code(0x30 + symbol, 8);
+        else if (symbol < 256)  put_code(0x190 + symbol - 144, 9);
+        else if (symbol < 280)  put_code(symbol - 256, 7);
+        else                    put_code(0xc0 + symbol - 280, 8);
+    };
+
+    put(1, 1);  // final block
+    put(1, 2);  // fixed Huffman codes
+
+    constexpr size_t        window{32768};
+    constexpr size_t        hash_bits{15};
+    std::vector<int64_t>    head(size_t(1) << hash_bits, -1);
+    auto    hash = [data](size_t i){return ((data[i] << 16 | data[i + 1] << 8 | data[i + 2]) * 2654435761u) >> (32 - hash_bits);};
+
+    for (size_t i = 0; i < size;)
+    {
+        size_t  length{0};
+        size_t  distance{0};
+        if (i + 3 <= size)
+        {
+            const uint32_t  h = hash(i);
+            const int64_t   candidate = head[h];
+            head[h] = static_cast<int64_t>(i);
+            if (candidate >= 0 && i - static_cast<size_t>(candidate) <= window)
+            {
+                const size_t    limit = std::min<size_t>(258, size - i);
+                const uint8_t   *a = data + candidate;
+                while (length < limit && a[length] == data[i + length])
+                {
+                    ++length;
+                }
+                distance = i - static_cast<size_t>(candidate);
+            }
+        }
+
+        if (length < 3)
+        {
+            put_symbol(data[i++]);
+            continue;
+        }
+
+        const size_t    l = static_cast<size_t>(std::upper_bound(length_base, length_base + 29, length) - length_base - 1);
+        put_symbol(static_cast<uint32_t>(257 + l));
+        put(static_cast<uint32_t>(length - length_base[l]), length_extra[l]);
+        const size_t    d = static_cast<size_t>(std::upper_bound(distance_base, distance_base + 30, distance) - distance_base - 1);
+        put_code(static_cast<uint32_t>(d), 5);
+        put(static_cast<uint32_t>(distance - distance_base[d]), distance_extra[d]);
+
+        const size_t    end = i + length;
+        for (++i; i < end && i + 3 <= size; ++i)
+        {
+            head[hash(i)] = static_cast<int64_t>(i);
+        }
+        i = end;
+    }
+    put_symbol(256);
+    put(0, 7);  // flush the last byte
+
+    uint32_t    a{1};
+    uint32_t    b{0};
+    for (size_t i = 0; i < size; ++i)
+    {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    const uint32_t  adler = b << 16 | a;
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        out.push_back(static_cast<uint8_t>(adler >> shift));
+    }
+    return out;
+}
+
+inline std::vector<uint8_t> encode_png(const uint8_t *rgba, size_t width, size_t height)
+/// PNG image of 8 bit, non premultiplied RGBA pixels.
+{
+    std::vector<uint8_t>    png{0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    auto    put32 = [](std::vector<uint8_t> &out, uint32_t value)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8)
+        {
+            out.push_back(static_cast<uint8_t>(value >> shift));
+        }
+    };
+    auto    chunk = [&png, &put32](const char *type, const std::vector<uint8_t> &data)
+    {
+        put32(png, static_cast<uint32_t>(data.size()));
+        const size_t    start = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), data.begin(), data.end());
+        put32(png, crc32(png.data() + start, png.size() - start));
+    };
+
+    std::vector<uint8_t>    header;
+    put32(header, static_cast<uint32_t>(width));
+    put32(header, static_cast<uint32_t>(height));
+    header.insert(header.end(), {8, 6, 0, 0, 0});   // 8 bit RGBA
+    chunk("IHDR", header);
+
+    // every row with the Sub filter, which turns flat areas into zeros.
+    const size_t            stride = width * 4;
+    std::vector<uint8_t>    filtered((stride + 1) * height);
+    for (size_t y = 0; y < height; ++y)
+    {
+        const uint8_t   *row = rgba + y * stride;
+        uint8_t         *target = filtered.data() + y * (stride + 1);
+        target[0] = 1;
+        for (size_t i = 0; i < stride; ++i)
+        {
+            target[i + 1] = static_cast<uint8_t>(row[i] - (i >= 4 ? row[i - 4] : 0));
+        }
+    }
+    chunk("IDAT", deflate(filtered.data(), filtered.size()));
+    chunk("IEND", {});
+
+    return png;
+}
+
+//-----------------------------------------------------------------------------
+inline bool parse_colour(std::string value, uint32_t &rgb)
+/// Reads a CSS colour given by name, as #rgb, #rrggbb or rgb() into
+/// 0xrrggbb.
+{
+    static const std::unordered_map<std::string, uint32_t>  names
+    {
+        {"black", 0x000000}, {"white", 0xffffff}, {"red", 0xff0000}, {"green", 0x008000},
+        {"blue", 0x0000ff}, {"yellow", 0xffff00}, {"cyan", 0x00ffff}, {"aqua", 0x00ffff},
+        {"magenta", 0xff00ff}, {"fuchsia", 0xff00ff}, {"gray", 0x808080}, {"grey", 0x808080},
+        {"silver", 0xc0c0c0}, {"maroon", 0x800000}, {"olive", 0x808000}, {"lime", 0x00ff00},
+        {"teal", 0x008080}, {"navy", 0x000080}, {"purple", 0x800080}, {"orange", 0xffa500},
+        {"brown", 0xa52a2a}, {"pink", 0xffc0cb}, {"beige", 0xf5f5dc}, {"gold", 0xffd700},
+        {"darkgreen", 0x006400}, {"darkblue", 0x00008b}, {"darkred", 0x8b0000}, {"darkgray", 0xa9a9a9},
+        {"darkgrey", 0xa9a9a9}, {"lightgray", 0xd3d3d3}, {"lightgrey", 0xd3d3d3}, {"lightblue", 0xadd8e6},
+        {"lightgreen", 0x90ee90}, {"violet", 0xee82ee}, {"indigo", 0x4b0082}, {"khaki", 0xf0e68c},
+        {"salmon", 0xfa8072}, {"steelblue", 0x4682b4}, {"tomato", 0xff6347}, {"turquoise", 0x40e0d0},
+        {"crimson", 0xdc143c}, {"coral", 0xff7f50}, {"chocolate", 0xd2691e}, {"tan", 0xd2b48c},
+    };
+
+    value.erase(std::remove_if(value.begin(), value.end(), [](char c){return std::isspace(static_cast<unsigned char>(c));}), value.end());
+    std::transform(value.begin(), value.end(), value.begin(), [](char c){return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));});
+
+    rgb = 0;
+    if (value == "currentcolor")
+    {
+        rgb = 0;
+    }
+    else if (!value.empty() && value[0] == '#' && (value.size() == 4 || value.size() == 7))
+    {
+        const auto  result = std::from_chars(value.data() + 1, value.data() + value.size(), rgb, 16);
+        if (result.ptr != value.data() + value.size())
+        {
+            return false;
+        }
+        if (value.size() == 4)
+        {
+            rgb = (rgb & 0xf00) * 0x1100 | (rgb & 0x0f0) * 0x110 | (rgb & 0x00f) * 0x11;
+        }
+    }
+    else if (value.compare(0, 4, "rgb(") == 0)
+    {
+        double      v[3]{};
+        const char  *p = value.data() + 4;
+        const char  *last = value.data() + value.size();
+        for (double &component : v)
+        {
+            p = parse_number(p, last, component);
+            if (p != last && *p == '%')
+            {
+                component *= 2.55;
+                ++p;
+            }
+            if (p != last && *p == ',')
+            {
+                ++p;
+            }
+        }
+        rgb = static_cast<uint32_t>(std::clamp(v[0], 0.0, 255.0)) << 16 | static_cast<uint32_t>(std::clamp(v[1], 0.0, 255.0)) << 8 | static_cast<uint32_t>(std::clamp(v[2], 0.0, 255.0));
+    }
+    else
+    {
+        const auto  ii = names.find(value);
+        if (ii == names.end())
+        {
+            return false;
+        }
+        rgb = ii->second;
+    }
+
+    return true;
+}
+
+class Rasterizer
+{
+    // Anti-aliased software renderer for thumbnails of documents. Supports
+    // Rect, Circle, Ellipse, Line, Polyline, Polygon, Path (curves and arcs
+    // flattened), MarkerBatch and Use with fill, stroke, opacity and transforms, styled
+    // by attributes or style attributes. Text, gradients and patterns are
+    // skipped, stroke joins are round and caps butt. The image is rendered in
+    // bands of rows on several threads by accumulating signed edge coverage.
+    struct Colour
+    {
+        float   r{0.0f};
+        float   g{0.0f};
+        float   b{0.0f};
+        float   a{1.0f};
+    };
+
+    struct Style
+    {
+        Colour  fill;
+        Colour  stroke;
+        bool    filled{true};
+        bool    stroked{false};
+        double  stroke_width{1.0};
+        double  fill_opacity{1.0};
+        double  stroke_opacity{1.0};
+        double  opacity{1.0};
+        bool    even_odd{false};
+        bool    visible{true};
+    };
+
+    struct Contour
+    {
+        std::vector<Point>  points;
+        bool                closed{false};
+    };
+
+    struct Shape
+    {
+        std::vector<std::vector<Point>> polygons;   ///< device space
+        Colour                          colour;     ///< premultiplied
+        bool                            even_odd{false};
+        double                          x0{0.0};
+        double                          y0{0.0};
+        double                          x1{0.0};
+        double                          y1{0.0};
+    };
+
+    static constexpr size_t band_height{32};
+
+    size_t                  width;
+    size_t                  requested_height;   ///< 0 to follow the aspect ratio of every document.
+    size_t                  height;             ///< of the last image rendered.
+    size_t                  threads;
+    Colour                  background{0.0f, 0.0f, 0.0f, 0.0f};
+    double                  view_scale{1.0};    ///< pixels per user unit, selecting LevelOfDetail levels.
+    std::vector<uint8_t>    pixels;
+
+    std::vector<Shape>                                  shapes;
+    std::unordered_map<std::string, const Base*>        ids;
+
+    static bool ParseColour(const std::string &value, Colour &colour)
+    {
+        uint32_t    rgb{0};
+        if (!parse_colour(value, rgb))
+        {
+            return false;
+        }
+        colour = {((rgb >> 16) & 0xff) / 255.0f, ((rgb >> 8) & 0xff) / 255.0f, (rgb & 0xff) / 255.0f, 1.0f};
+        return true;
+    }
+
+    static void Apply(Style &style, const std::string &name, const std::string &value)
+    {
+        if (name == "fill" || name == "stroke")
+        {
+            Colour  colour;
+            const bool  painted = value != "none" && value != "transparent" && ParseColour(value, colour);
+            (name == "fill" ? style.filled : style.stroked) = painted;
+            (name == "fill" ? style.fill : style.stroke) = colour;
+        }
+        else if (name == "stroke-width")    style.stroke_width = to_number(value, 1.0);
+        else if (name == "fill-opacity")    style.fill_opacity = to_number(value, 1.0);
+        else if (name == "stroke-opacity")  style.stroke_opacity = to_number(value, 1.0);
+        else if (name == "opacity")         style.opacity *= to_number(value, 1.0);
+        else if (name == "fill-rule")       style.even_odd = value == "evenodd";
+        else if (name == "display")         style.visible = style.visible && value != "none";
+        else if (name == "visibility")      style.visible = value != "hidden" && value != "collapse";
+    }
+
+    static Style    Inherit(Style style, const Base &element)
+    {
+        std::string text;
+        for (const auto &attribute : element.Attributes())
+        {
+            if (attribute.Name() == "style")
+            {
+                text = attribute.Value();
+            }
+            else
+            {
+                Apply(style, attribute.Name(), attribute.Value());
+            }
+        }
+
+        // style declarations take precedence over presentation attributes.
+        for (size_t start = 0; start < text.size();)
+        {
+            size_t  stop = text.find(';', start);
+            stop = stop == std::string::npos ? text.size() : stop;
+            const size_t    colon = text.find(':', start);
+            if (colon < stop)
+            {
+                auto    trim = [](std::string s)
+                {
+                    s.erase(0, s.find_first_not_of(" \t\r\n"));
+                    s.erase(s.find_last_not_of(" \t\r\n") + 1);
+                    return s;
+                };
+                Apply(style, trim(text.substr(start, colon - start)), trim(text.substr(colon + 1, stop - colon - 1)));
+            }
+            start = stop + 1;
+        }
+        return style;
+    }
+
+    static size_t   Segments(double length)
+    {
+        return static_cast<size_t>(std::clamp(std::ceil(length / 3.0), 1.0, 256.0));
+    }
+
+    static void Arc(Contour &contour, const Point &p0, double rx, double ry, double angle, bool large, bool sweep, const Point &p1, double scale)
+    /// Appends the elliptic arc from p0 to p1, @see SVG implementation notes F.6.5.
+    {
+        rx = std::fabs(rx);
+        ry = std::fabs(ry);
+        if (rx == 0.0 || ry == 0.0 || p0 == p1)
+        {
+            contour.points.push_back(p1);
+            return;
+        }
+
+        const double    pi = std::acos(-1.0);
+        const double    cos = std::cos(angle * pi / 180.0);
+        const double    sin = std::sin(angle * pi / 180.0);
+        const double    dx = (p0.X() - p1.X()) / 2.0;
+        const double    dy = (p0.Y() - p1.Y()) / 2.0;
+        const double    x1 = cos * dx + sin * dy;
+        const double    y1 = -sin * dx + cos * dy;
+
+        const double    lambda = x1 * x1 / (rx * rx) + y1 * y1 / (ry * ry);
+        if (lambda > 1.0)
+        {
+            rx *= std::sqrt(lambda);
+            ry *= std::sqrt(lambda);
+        }
+
+        const double    numerator = rx * rx * ry * ry - rx * rx * y1 * y1 - ry * ry * x1 * x1;
+        const double    denominator = rx * rx * y1 * y1 + ry * ry * x1 * x1;
+        const double    coefficient = std::sqrt(std::max(0.0, numerator / denominator)) * (large == sweep ? -1.0 : 1.0);
+        const double    cx1 = coefficient * rx * y1 / ry;
+        const double    cy1 = -coefficient * ry * x1 / rx;
+        const double    cx = cos * cx1 - sin * cy1 + (p0.X() + p1.X()) / 2.0;
+        const double    cy = sin * cx1 + cos * cy1 + (p0.Y() + p1.Y()) / 2.0;
+
+        auto    vector_angle = [](double ux, double uy, double vx, double vy){return std::atan2(ux * vy - uy * vx, ux * vx + uy * vy);};
+        const double    theta = vector_angle(1.0, 0.0, (x1 - cx1) / rx, (y1 - cy1) / ry);
+        double          delta = vector_angle((x1 - cx1) / rx, (y1 - cy1) / ry, (-x1 - cx1) / rx, (-y1 - cy1) / ry);
+        if (!sweep && delta > 0.0)
+        {
+            delta -= 2.0 * pi;
+        }
+        else if (sweep && delta < 0.0)
+        {
+            delta += 2.0 * pi;
+        }
+
+        const size_t    n = std::max<size_t>(4, Segments(std::fabs(delta) * std::max(rx, ry) * scale));
+        for (size_t i = 1; i < n; ++i)
+        {
+            const double    t = theta + delta * static_cast<double>(i) / static_cast<double>(n);
+            contour.points.push_back({cx + rx * std::cos(t) * cos - ry * std::sin(t) * sin, cy + rx * std::cos(t) * sin + ry * std::sin(t) * cos});
+        }
+        contour.points.push_back(p1);
+    }
+
+    static void Ellipse(std::vector<Contour> &contours, double cx, double cy, double rx, double ry, double scale)
+    {
+        if (rx <= 0.0 || ry <= 0.0)
+        {
+            return;
+        }
+        const size_t    n = std::max<size_t>(8, Segments(2.0 * std::acos(-1.0) * std::max(rx, ry) * scale));
+        Contour         contour;
+        contour.closed = true;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const double    t = 2.0 * std::acos(-1.0) * static_cast<double>(i) / static_cast<double>(n);
+            contour.points.push_back({cx + rx * std::cos(t), cy + ry * std::sin(t)});
+        }
+        contours.push_back(std::move(contour));
+    }
+
+    static void FlattenPath(std::vector<Contour> &contours, const Path &path, double scale)
+    {
+        const auto  &arguments = path.Arguments();
+        size_t      offset{0};
+        Point       current;
+        Point       start;
+        Point       control;    ///< last control point, reflected by S and T.
+        char        previous{0};
+        Contour     contour;
+
+        auto    finish = [&contours, &contour]()
+        {
+            if (contour.points.size() > 1)
+            {
+                contours.push_back(contour);
+            }
+            contour = Contour();
+        };
+        auto    cubic = [&contour, scale](const Point &p0, const Point &c1, const Point &c2, const Point &p1)
+        {
+            const size_t    n = Segments(((c1 - p0).Length() + (c2 - c1).Length() + (p1 - c2).Length()) * scale);
+            for (size_t i = 1; i <= n; ++i)
+            {
+                const double    t = static_cast<double>(i) / static_cast<double>(n);
+                const double    u = 1.0 - t;
+                contour.points.push_back(p0 * (u * u * u) + c1 * (3.0 * u * u * t) + c2 * (3.0 * u * t * t) + p1 * (t * t * t));
+            }
+        };
+
+        for (const char command : path.Commands())
+        {
+            double          v[7];
+            arguments.Copy(offset, Path::ArgumentCount(command), v);
+            offset += Path::ArgumentCount(command);
+
+            const bool      relative = std::islower(static_cast<unsigned char>(command)) != 0;
+            const char      upper = static_cast<char>(std::toupper(static_cast<unsigned char>(command)));
+            const Point     origin = relative ? current : Point();
+            auto            point = [&origin, v](size_t i){return origin + Point(v[i], v[i + 1]);};
+            const bool      curve = previous == 'C' || previous == 'S';
+            const bool      quadratic = previous == 'Q' || previous == 'T';
+
+            switch (upper)
+            {
+            case 'M':
+                finish();
+                current = start = point(0);
+                contour.points.push_back(current);
+                break;
+            case 'L':
+                current = point(0);
+                contour.points.push_back(current);
+                break;
+            case 'H':
+                current = Point(relative ? current.X() + v[0] : v[0], current.Y());
+                contour.points.push_back(current);
+                break;
+            case 'V':
+                current = Point(current.X(), relative ? current.Y() + v[0] : v[0]);
+                contour.points.push_back(current);
+                break;
+            case 'C':
+                cubic(current, point(0), point(2), point(4));
+                control = point(2);
+                current = point(4);
+                break;
+            case 'S':
+            {
+                const Point c1 = curve ? current * 2.0 - control : current;
+                cubic(current, c1, point(0), point(2));
+                control = point(0);
+                current = point(2);
+                break;
+            }
+            case 'Q':
+            case 'T':
+            {
+                const Point c = upper == 'Q' ? point(0) : (quadratic ? current * 2.0 - control : current);
+                const Point end = upper == 'Q' ? point(2) : point(0);
+                cubic(current, current + (c - current) * (2.0 / 3.0), end + (c - end) * (2.0 / 3.0), end);
+                control = c;
+                current = end;
+                break;
+            }
+            case 'A':
+                Arc(contour, current, v[0], v[1], v[2], v[3] != 0.0, v[4] != 0.0, point(5), scale);
+                current = point(5);
+                break;
+            case 'Z':
+                contour.closed = true;
+                finish();
+                current = start;
+                contour.points.push_back(current);
+                break;
+            }
+            if (contour.points.empty())
+            {
+                contour.points.push_back(current);
+            }
+            previous = upper;
+        }
+        finish();
+    }
+
+    static std::vector<Contour> Geometry(const Base &element, double scale)
+    /// Contours of the element in user space. Shapes given by attributes are
+    /// recognised by tag, so sliced copies held as Base render as well.
+    {
+        if (auto fixed = dynamic_cast<const FixedBase*>(&element))
+        {
+            return Geometry(*fixed->Expand(), scale);
+        }
+
+        std::vector<Contour>    contours;
+        double                  v[6];
+        auto    numbers = [&element, &v](std::initializer_list<const char*> names)
+        {
+            double  *value = v;
+            for (const char *name : names)
+            {
+                *value++ = element.NumericAttribute(name);
+            }
+            return true;
+        };
+        if (element.Tag() == "rect")
+        {
+            if (numbers({"x", "y", "width", "height", "rx", "ry"}) && v[2] > 0.0 && v[3] > 0.0)
+            {
+                const double    rx = std::min(v[2] / 2.0, element.FindAttribute("rx") != nullptr ? v[4] : v[5]);
+                const double    ry = std::min(v[3] / 2.0, element.FindAttribute("ry") != nullptr ? v[5] : v[4]);
+                Contour         contour;
+                contour.closed = true;
+                if (rx <= 0.0 || ry <= 0.0)
+                {
+                    contour.points = {{v[0], v[1]}, {v[0] + v[2], v[1]}, {v[0] + v[2], v[1] + v[3]}, {v[0], v[1] + v[3]}};
+                }
+                else
+                {
+                    contour.points.push_back({v[0] + rx, v[1]});
+                    contour.points.push_back({v[0] + v[2] - rx, v[1]});
+                    Arc(contour, contour.points.back(), rx, ry, 0.0, false, true, {v[0] + v[2], v[1] + ry}, scale);
+                    contour.points.push_back({v[0] + v[2], v[1] + v[3] - ry});
+                    Arc(contour, contour.points.back(), rx, ry, 0.0, false, true, {v[0] + v[2] - rx, v[1] + v[3]}, scale);
+                    contour.points.push_back({v[0] + rx, v[1] + v[3]});
+                    Arc(contour, contour.points.back(), rx, ry, 0.0, false, true, {v[0], v[1] + v[3] - ry}, scale);
+                    contour.points.push_back({v[0], v[1] + ry});
+                    Arc(contour, contour.points.back(), rx, ry, 0.0, false, true, {v[0] + rx, v[1]}, scale);
+                }
+                contours.push_back(std::move(contour));
+            }
+        }
+        else if (element.Tag() == "circle")
+        {
+            if (numbers({"cx", "cy", "r"}))
+            {
+                Ellipse(contours, v[0], v[1], v[2], v[2], scale);
+            }
+        }
+        else if (element.Tag() == "ellipse")
+        {
+            if (numbers({"cx", "cy", "rx", "ry"}))
+            {
+                Ellipse(contours, v[0], v[1], v[2], v[3], scale);
+            }
+        }
+        else if (element.Tag() == "line")
+        {
+            if (numbers({"x1", "y1", "x2", "y2"}))
+            {
+                contours.push_back({{{v[0], v[1]}, {v[2], v[3]}}, false});
+            }
+        }
+        else if (auto poly = dynamic_cast<const PolyBase*>(&element))
+        {
+            contours.push_back({poly->Points(), dynamic_cast<const Polygon*>(poly) != nullptr});
+        }
+        else if (auto path = dynamic_cast<const Path*>(&element))
+        {
+            FlattenPath(contours, *path, scale);
+        }
+        else if (auto batch = dynamic_cast<const MarkerBatch*>(&element))
+        {
+            FlattenPath(contours, batch->Combined(), scale);
+        }
+        return contours;
+    }
+
+    static double   Area(const std::vector<Point> &polygon)
+    {
+        double  area{0.0};
+        for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++)
+        {
+            area += polygon[j].X() * polygon[i].Y() - polygon[i].X() * polygon[j].Y();
+        }
+        return area / 2.0;
+    }
+
+    void    AddShape(std::vector<std::vector<Point>> polygons, const Colour &colour, double alpha, bool even_odd)
+    {
+        Shape   shape;
+        shape.colour = {colour.r * static_cast<float>(alpha), colour.g * static_cast<float>(alpha), colour.b * static_cast<float>(alpha), static_cast<float>(alpha)};
+        shape.even_odd = even_odd;
+        shape.x0 = shape.y0 = std::numeric_limits<double>::max();
+        shape.x1 = shape.y1 = std::numeric_limits<double>::lowest();
+        for (const auto &polygon : polygons)
+        {
+            for (const auto &p : polygon)
+            {
+                if (!std::isfinite(p.X()) || !std::isfinite(p.Y()))
+                {
+                    return;
+                }
+                shape.x0 = std::min(shape.x0, p.X());
+                shape.y0 = std::min(shape.y0, p.Y());
+                shape.x1 = std::max(shape.x1, p.X());
+                shape.y1 = std::max(shape.y1, p.Y());
+            }
+        }
+        if (alpha <= 0.0 || shape.x1 < 0.0 || shape.y1 < 0.0 || shape.x0 > static_cast<double>(width) || shape.y0 > static_cast<double>(height))
+        {
+            return;
+        }
+        shape.polygons = std::move(polygons);
+        shapes.push_back(std::move(shape));
+    }
+
+    void    AddStroke(const std::vector<Contour> &contours, double half_width, const Colour &colour, double alpha)
+    /// Strokes the device space contours with a quad per segment and discs
+    /// at the joins, all oriented alike so that overlaps do not cancel.
+    {
+        std::vector<std::vector<Point>> polygons;
+        auto    add = [&polygons](std::vector<Point> polygon)
+        {
+            if (Area(polygon) < 0.0)
+            {
+                std::reverse(polygon.begin(), polygon.end());
+            }
+            polygons.push_back(std::move(polygon));
+        };
+        auto    disc = [&add, half_width](const Point &center)
+        {
+            std::vector<Point>  polygon;
+            for (int i = 0; i < 8; ++i)
+            {
+                const double    t = std::acos(-1.0) * i / 4.0;
+                polygon.push_back(center + Point(std::cos(t), std::sin(t)) * half_width);
+            }
+            add(std::move(polygon));
+        };
+
+        for (const auto &contour : contours)
+        {
+            const auto      &p = contour.points;
+            const size_t    segments = contour.closed ? p.size() : p.size() - 1;
+            for (size_t i = 0; i < segments && p.size() > 1; ++i)
+            {
+                const Point &a = p[i];
+                const Point &b = p[(i + 1) % p.size()];
+                const Point direction = b - a;
+                const double    length = direction.Length();
+                if (length == 0.0)
+                {
+                    continue;
+                }
+                const Point normal = Point(-direction.Y(), direction.X()) * (half_width / length);
+                add({a + normal, b + normal, b - normal, a - normal});
+                if (half_width >= 0.75 && (contour.closed || i + 1 < segments))
+                {
+                    disc(b);
+                }
+            }
+        }
+        AddShape(std::move(polygons), colour, alpha, false);
+    }
+
+    void    Collect(const Base &element, const Transform &ctm, const Style &inherited, int depth)
+    {
+        const Style style = Inherit(inherited, element);
+        if (!style.visible || depth > 32)
+        {
+            return;
+        }
+
+        Transform   transform = ctm;
+        try
+        {
+            transform = ctm * element.GetTransform();
+        }
+        catch (const std::invalid_argument &)
+        {
+        }
+
+        if (auto detail = dynamic_cast<const LevelOfDetail*>(&element))
+        {
+            if (!detail->Objects().empty())
+            {
+                Collect(*detail->Objects()[detail->LevelAt(view_scale)], transform, style, depth + 1);
+            }
+            return;
+        }
+        if (auto group = dynamic_cast<const GroupBase*>(&element))
+        {
+            if (dynamic_cast<const Text*>(group) == nullptr && (group->Tag() == "g" || group->Tag() == "a" || group->Tag() == "svg" || group->Tag() == "switch"))
+            {
+                for (const auto &object : group->Objects())
+                {
+                    Collect(*object, transform, style, depth + 1);
+                }
+            }
+            return;
+        }
+        if (auto use = dynamic_cast<const Use*>(&element))
+        {
+            const auto  *href = use->FindAttribute("href") != nullptr ? use->FindAttribute("href") : use->FindAttribute("xlink:href");
+            const auto  ii = href != nullptr && !href->Value().empty() ? ids.find(href->Value().substr(1)) : ids.end();
+            if (ii != ids.end())
+            {
+                Collect(*ii->second, transform * Transform().Translate(use->NumericAttribute("x"), use->NumericAttribute("y")), style, depth + 1);
+            }
+            return;
+        }
+
+        const double    scale = std::sqrt(std::fabs(transform.Determinant()));
+        auto            contours = Geometry(element, scale);
+        for (auto &contour : contours)
+        {
+            for (auto &p : contour.points)
+            {
+                p = transform.Apply(p);
+            }
+        }
+
+        if (style.filled && element.Tag() != "line")
+        {
+            std::vector<std::vector<Point>> polygons;
+            for (const auto &contour : contours)
+            {
+                polygons.push_back(contour.points);
+            }
+            AddShape(std::move(polygons), style.fill, style.fill.a * style.fill_opacity * style.opacity, style.even_odd);
+        }
+        if (style.stroked && style.stroke_width > 0.0)
+        {
+            AddStroke(contours, style.stroke_width * scale / 2.0, style.stroke, style.stroke.a * style.stroke_opacity * style.opacity);
+        }
+    }
+
+    void    Index(const Base &element)
+    {
+        if (const auto *id = element.FindAttribute("id"))
+        {
+            ids.emplace(id->Value(), &element);
+        }
+        if (auto group = dynamic_cast<const GroupBase*>(&element))
+        {
+            for (const auto &object : group->Objects())
+            {
+                Index(*object);
+            }
+        }
+    }
+
+    void    Edge(std::vector<float> &accumulation, size_t rows, Point p0, Point p1) const
+    /// Accumulates the signed area coverage of an edge, @see font-rs. Parts
+    /// left and right of the image are moved to its border.
+    {
+        const double    w = static_cast<double>(width);
+        for (const double border : {0.0, w})
+        {
+            if ((p0.X() < border) != (p1.X() < border) && p0.X() != border && p1.X() != border)
+            {
+                const double    t = (border - p0.X()) / (p1.X() - p0.X());
+                const Point     m(border, p0.Y() + t * (p1.Y() - p0.Y()));
+                Edge(accumulation, rows, p0, m);
+                Edge(accumulation, rows, m, p1);
+                return;
+            }
+        }
+        p0 = {std::clamp(p0.X(), 0.0, w), p0.Y()};
+        p1 = {std::clamp(p1.X(), 0.0, w), p1.Y()};
+        if (p0.Y() == p1.Y())
+        {
+            return;
+        }
+
+        const float     direction = p0.Y() < p1.Y() ? 1.0f : -1.0f;
+        if (p0.Y() > p1.Y())
+        {
+            std::swap(p0, p1);
+        }
+        const size_t    stride = width + 2;
+        const double    dxdy = (p1.X() - p0.X()) / (p1.Y() - p0.Y());
+        double          x = p0.X();
+        if (p0.Y() < 0.0)
+        {
+            x -= p0.Y() * dxdy;
+        }
+
+        const size_t    first = static_cast<size_t>(std::clamp(p0.Y(), 0.0, static_cast<double>(rows)));
+        const size_t    last = static_cast<size_t>(std::clamp(std::ceil(p1.Y()), 0.0, static_cast<double>(rows)));
+        for (size_t y = first; y < last; ++y)
+        {
+            float           *line = accumulation.data() + y * stride;
+            const double    dy = std::min(static_cast<double>(y + 1), p1.Y()) - std::max(static_cast<double>(y), p0.Y());
+            const double    x_next = std::clamp(x + dxdy * dy, 0.0, static_cast<double>(width));
+            const float     d = static_cast<float>(dy) * direction;
+            const double    x0 = std::min(x, x_next);
+            const double    x1 = std::max(x, x_next);
+            const double    x0_floor = std::floor(x0);
+            const size_t    x0i = static_cast<size_t>(x0_floor);
+            const size_t    x1i = static_cast<size_t>(std::ceil(x1));
+
+            if (x1i <= x0i + 1)
+            {
+                const float xm = static_cast<float>(0.5 * (x + x_next) - x0_floor);
+                line[x0i] += d - d * xm;
+                line[x0i + 1] += d * xm;
+            }
+            else
+            {
+                const double    s = 1.0 / (x1 - x0);
+                const double    x0f = x0 - x0_floor;
+                const double    a0 = 0.5 * s * (1.0 - x0f) * (1.0 - x0f);
+                const double    x1f = x1 - std::ceil(x1) + 1.0;
+                const double    am = 0.5 * s * x1f * x1f;
+                line[x0i] += d * static_cast<float>(a0);
+                if (x1i == x0i + 2)
+                {
+                    line[x0i + 1] += d * static_cast<float>(1.0 - a0 - am);
+                }
+                else
+                {
+                    const double    a1 = s * (1.5 - x0f);
+                    line[x0i + 1] += d * static_cast<float>(a1 - a0);
+                    for (size_t xi = x0i + 2; xi < x1i - 1; ++xi)
+                    {
+                        line[xi] += d * static_cast<float>(s);
+                    }
+                    const double    a2 = a1 + static_cast<double>(x1i - x0i - 3) * s;
+                    line[x1i - 1] += d * static_cast<float>(1.0 - a2 - am);
+                }
+                line[x1i] += d * static_cast<float>(am);
+            }
+            x = x_next;
+        }
+    }
+
+    void    RenderBand(size_t band, const std::vector<size_t> &indices, std::vector<float> &accumulation, std::vector<float> &colours)
+    {
+        const size_t    top = band * band_height;
+        const size_t    rows = std::min(band_height, height - top);
+        const size_t    stride = width + 2;
+
+        colours.assign(width * rows * 4, 0.0f);
+        for (size_t i = 0; i < width * rows; ++i)
+        {
+            colours[i * 4 + 0] = background.r * background.a;
+            colours[i * 4 + 1] = background.g * background.a;
+            colours[i * 4 + 2] = background.b * background.a;
+            colours[i * 4 + 3] = background.a;
+        }
+
+        for (const size_t index : indices)
+        {
+            const Shape &shape = shapes[index];
+            const Point offset(0.0, static_cast<double>(top));
+            for (const auto &polygon : shape.polygons)
+            {
+                for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++)
+                {
+                    Edge(accumulation, rows, polygon[j] - offset, polygon[i] - offset);
+                }
+            }
+
+            const size_t    x_first = static_cast<size_t>(std::clamp(std::floor(shape.x0), 0.0, static_cast<double>(width)));
+            const size_t    x_last = static_cast<size_t>(std::clamp(std::ceil(shape.x1) + 3.0, 0.0, static_cast<double>(stride)));
+            const size_t    y_first = static_cast<size_t>(std::clamp(std::floor(shape.y0) - static_cast<double>(top), 0.0, static_cast<double>(rows)));
+            const size_t    y_last = static_cast<size_t>(std::clamp(std::ceil(shape.y1) - static_cast<double>(top) + 1.0, 0.0, static_cast<double>(rows)));
+            for (size_t y = y_first; y < y_last; ++y)
+            {
+                float   *line = accumulation.data() + y * stride;
+                float   *target = colours.data() + y * width * 4;
+                float   sum{0.0f};
+                for (size_t x = x_first; x < x_last; ++x)
+                {
+                    sum += line[x];
+                    line[x] = 0.0f;
+
+                    float   coverage = std::fabs(sum);
+                    if (shape.even_odd)
+                    {
+                        coverage = std::fmod(coverage, 2.0f);
+                        coverage = coverage > 1.0f ? 2.0f - coverage : coverage;
+                    }
+                    coverage = std::min(coverage, 1.0f);
+                    if (x < width && coverage > 1.0f / 512.0f)
+                    {
+                        float       *pixel = target + x * 4;
+                        const float a = shape.colour.a * coverage;
+                        pixel[0] = shape.colour.r * coverage + pixel[0] * (1.0f - a);
+                        pixel[1] = shape.colour.g * coverage + pixel[1] * (1.0f - a);
+                        pixel[2] = shape.colour.b * coverage + pixel[2] * (1.0f - a);
+                        pixel[3] = a + pixel[3] * (1.0f - a);
+                    }
+                }
+            }
+        }
+
+        uint8_t *out = pixels.data() + top * width * 4;
+        for (size_t i = 0; i < width * rows; ++i)
+        {
+            const float a = colours[i * 4 + 3];
+            for (size_t c = 0; c < 3; ++c)
+            {
+                out[i * 4 + c] = static_cast<uint8_t>(std::lround(a > 0.0f ? std::min(1.0f, colours[i * 4 + c] / a) * 255.0f : 0.0f));
+            }
+            out[i * 4 + 3] = static_cast<uint8_t>(std::lround(std::min(1.0f, a) * 255.0f));
+        }
+    }
+
+public:
+    Rasterizer(size_t width, size_t height = 0)
+    /// Renders width pixels wide images, height 0 follows the aspect ratio of
+    /// the document.
+        : width(width),
+          requested_height(height),
+          height(height),
+          threads(std::max<size_t>(1, std::thread::hardware_concurrency()))
+    {}
+
+    Rasterizer& Threads(size_t threads)
+    {
+        this->threads = std::max<size_t>(1, threads);
+        return *this;
+    }
+
+    Rasterizer& Background(const std::string &colour, double opacity = 1.0)
+    /// Colour behind the drawing, transparent by default.
+    {
+        background = Colour{0.0f, 0.0f, 0.0f, 0.0f};
+        if (ParseColour(colour, background))
+        {
+            background.a = static_cast<float>(opacity);
+        }
+        return *this;
+    }
+
+    size_t  Width() const {return width;}
+    size_t  Height() const {return height;}
+
+    const std::vector<uint8_t>& Pixels() const
+    /// 8 bit, non premultiplied RGBA pixels, row by row.
+    {
+        return pixels;
+    }
+
+    Rasterizer& Render(const Document &document)
+    {
+        // view box mapped to the image as by preserveAspectRatio="xMidYMid meet".
+        height = requested_height;
+        double  box[4]{0.0, 0.0, document.NumericAttribute("width", 0.0), document.NumericAttribute("height", 0.0)};
+        document.GetViewBox(box);
+        if (box[2] <= 0.0 || box[3] <= 0.0)
+        {
+            box[2] = static_cast<double>(width);
+            box[3] = height != 0 ? static_cast<double>(height) : static_cast<double>(width);
+        }
+        if (height == 0)
+        {
+            height = std::max<size_t>(1, static_cast<size_t>(std::lround(static_cast<double>(width) * box[3] / box[2])));
+        }
+
+        const double    scale = std::min(static_cast<double>(width) / box[2], static_cast<double>(height) / box[3]);
+        view_scale = scale;
+        Transform       viewport;
+        viewport.Translate(-box[0], -box[1])
+                .Scale(scale)
+                .Translate((static_cast<double>(width) - box[2] * scale) / 2.0, (static_cast<double>(height) - box[3] * scale) / 2.0);
+
+        shapes.clear();
+        ids.clear();
+        Index(document);
+        const Style root = Inherit(Style(), document);
+        for (const auto &object : document.Objects())
+        {
+            Collect(*object, viewport, root, 0);
+        }
+
+        const size_t                        bands = (height + band_height - 1) / band_height;
+        std::vector<std::vector<size_t>>    buckets(bands);
+        for (size_t i = 0; i < shapes.size(); ++i)
+        {
+            const double    first = std::clamp(std::floor(shapes[i].y0 / band_height), 0.0, static_cast<double>(bands - 1));
+            const double    last = std::clamp(std::floor(shapes[i].y1 / band_height), 0.0, static_cast<double>(bands - 1));
+            for (size_t band = static_cast<size_t>(first); band <= static_cast<size_t>(last); ++band)
+            {
+                buckets[band].push_back(i);
+            }
+        }
+
+        pixels.assign(width * height * 4, 0);
+        std::atomic<size_t>         next{0};
+        std::vector<std::thread>    workers;
+        auto    work = [this, &next, &buckets, bands]()
+        {
+            std::vector<float>  accumulation((width + 2) * band_height, 0.0f);
+            std::vector<float>  colours;
+            for (size_t band = next++; band < bands; band = next++)
+            {
+                RenderBand(band, buckets[band], accumulation, colours);
+            }
+        };
+        for (size_t i = 1; i < std::min(threads, bands); ++i)
+        {
+            workers.emplace_back(work);
+        }
+        work();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+
+        return *this;
+    }
+
+    std::vector<uint8_t>    Png() const
+    {
+        return encode_png(pixels.data(), width, height);
+    }
+
+    void    WritePng(const std::string &path) const
+    {
+        const auto      png = Png();
+        std::ofstream   file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+        if (!file)
+        {
+            throw std::runtime_error("simple_svg::Rasterizer: cannot write " + path);
+        }
+    }
+};
+
+} // namespace simple_svg
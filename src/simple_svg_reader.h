@@ -0,0 +1,571 @@
+#pragma once
+#include "simple_svg_writer.h"
+#include <fstream>
+#include <string_view>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SIMPLE_SVG_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace simple_svg
+{
+
+//-----------------------------------------------------------------------------
+class MappedFile
+{
+    // Read only view of a whole file, memory mapped where supported and read
+    // into memory elsewhere.
+    const char  *data{nullptr};
+    size_t      size{0};
+    std::string buffer;
+
+public:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    explicit MappedFile(const std::string &path)
+    {
+#if defined(SIMPLE_SVG_MMAP)
+        const int   file = ::open(path.c_str(), O_RDONLY);
+        struct stat status;
+        if (file < 0 || ::fstat(file, &status) != 0)
+        {
+            if (file >= 0)
+            {
+                ::close(file);
+            }
+            throw std::runtime_error("simple_svg::MappedFile: cannot open " + path);
+        }
+
+        size = static_cast<size_t>(status.st_size);
+        if (size != 0)
+        {
+            void    *mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+            if (mapping == MAP_FAILED)
+            {
+                ::close(file);
+                throw std::runtime_error("simple_svg::MappedFile: cannot map " + path);
+            }
+            ::madvise(mapping, size, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(mapping);
+        }
+        ::close(file);
+#else
+        std::ifstream   file(path, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("simple_svg::MappedFile: cannot open " + path);
+        }
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data = buffer.data();
+        size = buffer.size();
+#endif
+    }
+
+    ~MappedFile()
+    {
+#if defined(SIMPLE_SVG_MMAP)
+        if (data != nullptr)
+        {
+            ::munmap(const_cast<char*>(data), size);
+        }
+#endif
+    }
+
+    std::string_view    View() const {return {data, size};}
+};
+
+//-----------------------------------------------------------------------------
+class Reader
+{
+    // Fast, non-validating SVG reader, e.g. for filling in designer made
+    // templates. The text is tokenized in place; strings are only allocated
+    // for the values stored in the resulting elements. Known tags become their
+    // classes, with points and d parsed into coordinates written back with
+    // the digits read (Storage::Exact), all other tags become generic
+    // Elements. Attribute values, transforms included, are kept as written. Comments, processing instructions
+    // and the document type are skipped, white space between tags is dropped.
+    // Elements nested deeper than max_depth fail, rather than overflowing the
+    // stack.
+    using Attributes = std::vector<std::pair<std::string_view, std::string>>;
+
+    static constexpr size_t max_depth{256};
+
+    const char  *begin;
+    const char  *current;
+    const char  *end;
+
+    [[noreturn]] void   Fail(const std::string &message) const
+    {
+        throw std::runtime_error("simple_svg::Reader: " + message + " at offset " + std::to_string(current - begin));
+    }
+
+    bool    StartsWith(std::string_view prefix) const
+    {
+        return static_cast<size_t>(end - current) >= prefix.size() && std::memcmp(current, prefix.data(), prefix.size()) == 0;
+    }
+
+    void    SkipPast(std::string_view terminator)
+    {
+        const std::string_view  rest(current, static_cast<size_t>(end - current));
+        const size_t            position = rest.find(terminator);
+        if (position == std::string_view::npos)
+        {
+            Fail("missing " + std::string(terminator));
+        }
+        current += position + terminator.size();
+    }
+
+    void    SkipSpace()
+    {
+        while (current != end && std::isspace(static_cast<unsigned char>(*current)))
+        {
+            ++current;
+        }
+    }
+
+    void    SkipMarkup()
+    /// Skips white space, comments, processing instructions and doctype.
+    {
+        for (SkipSpace(); current != end; SkipSpace())
+        {
+            if (StartsWith("<!--"))
+            {
+                SkipPast("-->");
+            }
+            else if (StartsWith("<?"))
+            {
+                SkipPast("?>");
+            }
+            else if (StartsWith("<!DOCTYPE"))
+            {
+                const char  *bracket = static_cast<const char*>(std::memchr(current, '[', static_cast<size_t>(end - current)));
+                const char  *close = static_cast<const char*>(std::memchr(current, '>', static_cast<size_t>(end - current)));
+                if (bracket != nullptr && close != nullptr && bracket < close)
+                {
+                    SkipPast("]");
+                }
+                SkipPast(">");
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+
+    std::string_view    Name()
+    {
+        const char  *start = current;
+        while (current != end && !std::isspace(static_cast<unsigned char>(*current)) && *current != '=' && *current != '>' && *current != '/')
+        {
+            ++current;
+        }
+        if (current == start)
+        {
+            Fail("expected a name");
+        }
+        return {start, static_cast<size_t>(current - start)};
+    }
+
+    static void Decode(std::string_view text, std::string &decoded)
+    /// Appends text with the XML entities replaced by the characters.
+    {
+        for (size_t amp = text.find('&'); amp != std::string_view::npos; amp = text.find('&'))
+        {
+            decoded.append(text.data(), amp);
+            text.remove_prefix(amp);
+
+            const size_t    semicolon = text.find(';');
+            if (semicolon == std::string_view::npos)
+            {
+                break;
+            }
+            const std::string_view  entity = text.substr(1, semicolon - 1);
+            uint32_t                code{0};
+            if      (entity == "amp")   code = '&';
+            else if (entity == "lt")    code = '<';
+            else if (entity == "gt")    code = '>';
+            else if (entity == "quot")  code = '"';
+            else if (entity == "apos")  code = '\'';
+            else if (entity.size() > 1 && entity[0] == '#')
+            {
+                const bool  hex = entity[1] == 'x' || entity[1] == 'X';
+                std::from_chars(entity.data() + (hex ? 2 : 1), entity.data() + entity.size(), code, hex ? 16 : 10);
+            }
+
+            if (code == 0)
+            {
+                decoded += '&';     // unknown entity, kept as it is.
+                text.remove_prefix(1);
+                continue;
+            }
+
+            if (code < 0x80)
+            {
+                decoded += static_cast<char>(code);
+            }
+            else if (code < 0x800)
+            {
+                decoded += static_cast<char>(0xc0 | (code >> 6));
+                decoded += static_cast<char>(0x80 | (code & 0x3f));
+            }
+            else if (code < 0x10000)
+            {
+                decoded += static_cast<char>(0xe0 | (code >> 12));
+                decoded += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+                decoded += static_cast<char>(0x80 | (code & 0x3f));
+            }
+            else
+            {
+                decoded += static_cast<char>(0xf0 | (code >> 18));
+                decoded += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+                decoded += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+                decoded += static_cast<char>(0x80 | (code & 0x3f));
+            }
+            text.remove_prefix(semicolon + 1);
+        }
+        decoded.append(text.data(), text.size());
+    }
+
+    static bool NumberStart(const char *p, const char *last)
+    {
+        return p != last && (std::isdigit(static_cast<unsigned char>(*p)) || *p == '-' || *p == '+' || *p == '.');
+    }
+
+    static void SkipSeparators(const char *&p, const char *last)
+    {
+        while (p != last && (std::isspace(static_cast<unsigned char>(*p)) || *p == ','))
+        {
+            ++p;
+        }
+    }
+
+    static bool ParsePoints(const std::string &text, std::vector<Point> &points)
+    {
+        const char  *p = text.data();
+        const char  *last = text.data() + text.size();
+        for (SkipSeparators(p, last); p != last; SkipSeparators(p, last))
+        {
+            double  x{};
+            double  y{};
+            const char  *next = parse_number(p, last, x);
+            if (next == p)
+            {
+                return false;
+            }
+            SkipSeparators(next, last);
+            p = parse_number(next, last, y);
+            if (p == next)
+            {
+                return false;
+            }
+            points.push_back({x, y});
+        }
+        return true;
+    }
+
+    static bool ParsePath(const std::string &text, Path &path)
+    {
+        const char  *p = text.data();
+        const char  *last = text.data() + text.size();
+        char        command{0};
+        for (SkipSeparators(p, last); p != last; SkipSeparators(p, last))
+        {
+            if (std::isalpha(static_cast<unsigned char>(*p)))
+            {
+                command = *p++;
+                if (command == 'Z' || command == 'z')
+                {
+                    path.Command(command, {});
+                    continue;
+                }
+                SkipSeparators(p, last);
+            }
+            if (command == 0 || command == 'Z' || command == 'z' || Path::ArgumentCount(command) == 0)
+            {
+                return false;
+            }
+
+            double          values[7];
+            const size_t    count = Path::ArgumentCount(command);
+            for (size_t k = 0; k < count; ++k)
+            {
+                if (k != 0)
+                {
+                    SkipSeparators(p, last);
+                }
+                if ((command == 'A' || command == 'a') && (k == 3 || k == 4) && p != last && (*p == '0' || *p == '1'))
+                {
+                    values[k] = *p++ == '1' ? 1.0 : 0.0;   // flags may be written without separators.
+                    continue;
+                }
+                const char  *next = parse_number(p, last, values[k]);
+                if (next == p)
+                {
+                    return false;
+                }
+                p = next;
+            }
+            path.Command(command, values);
+
+            // coordinates following a move are implicit line tos.
+            command = command == 'M' ? 'L' : command == 'm' ? 'l' : command;
+        }
+        return true;
+    }
+
+    static void AddAttributes(Base &element, const Attributes &attributes, std::initializer_list<std::string_view> skip = {})
+    {
+        for (const auto &attribute : attributes)
+        {
+            if (std::find(skip.begin(), skip.end(), attribute.first) != skip.end())
+            {
+                continue;
+            }
+            // kept as written, transforms included, GetTransform() parses them.
+            element.AddAttribute({std::string(attribute.first), attribute.second});
+        }
+    }
+
+    template<typename T>
+    static std::shared_ptr<Base>    Leaf(const Attributes &attributes)
+    {
+        auto    element = std::make_shared<T>();
+        AddAttributes(*element, attributes);
+        return element;
+    }
+
+    static std::shared_ptr<Base>    Create(std::string_view tag, const Attributes &attributes, std::vector<std::shared_ptr<Base>> &children)
+    {
+        auto    find = [&attributes](std::string_view name) -> const std::string*
+        {
+            auto ii = std::find_if(attributes.begin(), attributes.end(), [name](const auto &a){return a.first == name;});
+            return ii != attributes.end() ? &ii->second : nullptr;
+        };
+        const bool  only_text = children.size() == 1 && dynamic_cast<const CharacterData*>(children.front().get()) != nullptr;
+
+        std::shared_ptr<GroupBase>  group;
+        if (tag == "g")
+        {
+            const auto  *mode = find("inkscape:groupmode");
+            group = (mode != nullptr && *mode == "layer") ? std::shared_ptr<GroupBase>(std::make_shared<Layer>()) : std::make_shared<Group>();
+            group->ClearAttributes();
+        }
+        else if (tag == "text" && (children.empty() || only_text))
+        {
+            auto    text = std::make_shared<Text>(0.0, 0.0, children.empty() ? std::string() : static_cast<const CharacterData&>(*children.front()).Content());
+            text->ClearAttributes();
+            AddAttributes(*text, attributes);
+            return text;
+        }
+        else if (children.empty())
+        {
+            if (tag == "rect")      return Leaf<Rect>(attributes);
+            if (tag == "circle")    return Leaf<Circle>(attributes);
+            if (tag == "ellipse")   return Leaf<Ellipse>(attributes);
+            if (tag == "line")      return Leaf<Line>(attributes);
+            if (tag == "use")       return Leaf<Use>(attributes);
+
+            if (tag == "polyline" || tag == "polygon")
+            {
+                const auto          *text = find("points");
+                std::vector<Point>  points;
+                if (text == nullptr || ParsePoints(*text, points))
+                {
+                    // written back with the digits read.
+                    std::shared_ptr<PolyBase>   poly = tag == "polyline" ? std::shared_ptr<PolyBase>(std::make_shared<Polyline>()) : std::make_shared<Polygon>();
+                    poly->StoreAs(Storage::Exact);
+                    poly->Add(points);
+                    AddAttributes(*poly, attributes, {"points"});
+                    return poly;
+                }
+            }
+            if (tag == "path")
+            {
+                const auto  *text = find("d");
+                auto        path = std::make_shared<Path>();
+                path->StoreAs(Storage::Exact);
+                if (text == nullptr || ParsePath(*text, *path))
+                {
+                    AddAttributes(*path, attributes, {"d"});
+                    return path;
+                }
+            }
+
+            auto    element = std::make_shared<Base>(std::string(tag));
+            AddAttributes(*element, attributes);
+            return element;
+        }
+
+        if (!group)
+        {
+            group = std::make_shared<Element>(std::string(tag));
+        }
+        AddAttributes(*group, attributes);
+        for (auto &child : children)
+        {
+            group->AppendShared(std::move(child));
+        }
+        return group;
+    }
+
+    std::shared_ptr<Base>   ParseElement(std::string_view &tag, Attributes &attributes, size_t depth = 0)
+    /// Parses the element starting at current. The attributes of the element
+    /// are left in attributes, e.g. for the root element.
+    {
+        if (depth > max_depth)
+        {
+            Fail("elements nested too deep");
+        }
+        ++current;  // '<'
+        tag = Name();
+
+        for (SkipSpace(); current != end && *current != '>' && *current != '/'; SkipSpace())
+        {
+            const std::string_view  name = Name();
+            SkipSpace();
+            if (current == end || *current != '=')
+            {
+                Fail("expected = after " + std::string(name));
+            }
+            ++current;
+            SkipSpace();
+            if (current == end || (*current != '"' && *current != '\''))
+            {
+                Fail("expected quoted value of " + std::string(name));
+            }
+            const char  quote = *current++;
+            const char  *close = static_cast<const char*>(std::memchr(current, quote, static_cast<size_t>(end - current)));
+            if (close == nullptr)
+            {
+                Fail("unterminated value of " + std::string(name));
+            }
+            std::string value;
+            Decode({current, static_cast<size_t>(close - current)}, value);
+            attributes.emplace_back(name, std::move(value));
+            current = close + 1;
+        }
+
+        std::vector<std::shared_ptr<Base>>  children;
+        if (StartsWith("/>"))
+        {
+            current += 2;
+            return Create(tag, attributes, children);
+        }
+        if (current == end)
+        {
+            Fail("unterminated <" + std::string(tag));
+        }
+        ++current;  // '>'
+
+        std::string text;
+        auto        flush = [&text, &children]()
+        {
+            if (std::any_of(text.begin(), text.end(), [](char c){return !std::isspace(static_cast<unsigned char>(c));}))
+            {
+                children.push_back(std::make_shared<CharacterData>(text));
+            }
+            text.clear();
+        };
+
+        for (;;)
+        {
+            const char  *start = current;
+            const char  *open = static_cast<const char*>(std::memchr(current, '<', static_cast<size_t>(end - current)));
+            if (open == nullptr)
+            {
+                Fail("missing </" + std::string(tag) + ">");
+            }
+            Decode({start, static_cast<size_t>(open - start)}, text);
+            current = open;
+
+            if (StartsWith("</"))
+            {
+                current += 2;
+                if (Name() != tag)
+                {
+                    Fail("mismatched </" + std::string(tag) + ">");
+                }
+                SkipSpace();
+                if (current == end || *current != '>')
+                {
+                    Fail("expected >");
+                }
+                ++current;
+                break;
+            }
+            if (StartsWith("<![CDATA["))
+            {
+                current += 9;
+                const char  *data = current;
+                SkipPast("]]>");
+                text.append(data, static_cast<size_t>(current - 3 - data));
+                continue;
+            }
+            if (StartsWith("<!--") || StartsWith("<?"))
+            {
+                SkipPast(StartsWith("<!--") ? "-->" : "?>");
+                continue;
+            }
+
+            flush();
+            std::string_view    child_tag;
+            Attributes          child_attributes;
+            children.push_back(ParseElement(child_tag, child_attributes, depth + 1));
+        }
+        flush();
+
+        return Create(tag, attributes, children);
+    }
+
+public:
+    Reader(std::string_view text)
+        : begin(text.data()),
+          current(text.data()),
+          end(text.data() + text.size())
+    {}
+
+    Document    Read()
+    /// Reads the document, the root element must be <svg>.
+    {
+        current = begin;
+        SkipMarkup();
+        if (current == end || *current != '<')
+        {
+            Fail("expected <svg>");
+        }
+
+        std::string_view    tag;
+        Attributes          attributes;
+        auto                root = ParseElement(tag, attributes);
+        if (tag != "svg")
+        {
+            Fail("expected <svg>, found <" + std::string(tag) + ">");
+        }
+
+        Document    document;
+        document.ClearAttributes();
+        AddAttributes(document, attributes);
+        if (auto group = std::dynamic_pointer_cast<GroupBase>(root))
+        {
+            for (const auto &child : group->Objects())
+            {
+                document.AppendShared(child);
+            }
+        }
+        return document;
+    }
+
+    static Document ReadFile(const std::string &path)
+    {
+        MappedFile  file(path);
+        return Reader(file.View()).Read();
+    }
+};
+
+} // namespace simple_svg
@@ -0,0 +1,166 @@
+#pragma once
+#include "simple_svg_writer.h"
+#include <string_view>
+#include <unordered_map>
+
+namespace simple_svg
+{
+
+//-----------------------------------------------------------------------------
+class Slot : public Base
+{
+    // Placeholder for a piece of markup, e.g. a child element, filled in by
+    // Template::Fill() without escaping.
+    std::string name;
+public:
+    Slot(const Slot&) = default;
+    Slot(Slot&&) = default;
+    Slot& operator=(const Slot&) = default;
+    Slot& operator=(Slot&&) = default;
+
+    Slot(const std::string &name) : Base(std::string()), name(name) {}
+    virtual ~Slot() override {}
+
+    const std::string&  Name() const {return name;}
+
+    virtual void    Measure(Footprint &footprint) const override
+    {
+        Base::Measure(footprint);
+        footprint.objects += sizeof(Slot) - sizeof(Base);
+        footprint.strings += heap_bytes(name);
+    }
+
+    virtual void    Serialize(Sink &sink) const override
+    {
+        sink << '\x03' << name << '\x02';
+    }
+};
+
+//-----------------------------------------------------------------------------
+class Template
+{
+    // A document compiled into static byte segments with holes in between.
+    // Build the document once with Placeholder() values in attributes or
+    // text and Slot elements for markup, compile it, and Fill() writes only
+    // the values between the copied segments, without walking the tree.
+    //
+    //  simple_svg::Text    label(10, 20, simple_svg::Template::Placeholder("label"));
+    //  ...
+    //  simple_svg::Template    badge(document);
+    //  const size_t            label_index = badge.Index("label");
+    //  std::vector<std::string_view>   values(badge.Holes());
+    //  values[label_index] = "Passed";
+    //  badge.Fill(output, values);
+    struct Hole
+    {
+        size_t  offset;     ///< end of the static segment before the hole.
+        size_t  index;      ///< of the value filling the hole.
+        bool    escape;
+    };
+
+    std::string                             statics;
+    std::vector<Hole>                       holes;
+    std::unordered_map<std::string, size_t> indices;
+
+public:
+    static std::string  Placeholder(const std::string &name)
+    /// Value for an attribute or text content to be filled in, escaped
+    /// unless the attribute or Text is written unescaped.
+    {
+        // the '&' is written as "&amp;" where the value is escaped.
+        return '\x01' + name + "&\x02";
+    }
+
+    explicit Template(const Base &root)
+    {
+        std::string text;
+        StringSink  sink(text);
+        root.Serialize(sink);
+
+        statics.reserve(text.size());
+        for (size_t position = 0; position < text.size();)
+        {
+            const size_t    start = text.find_first_of("\x01\x03", position);
+            const size_t    stop = start != std::string::npos ? text.find('\x02', start) : std::string::npos;
+            if (stop == std::string::npos)
+            {
+                statics.append(text, position, std::string::npos);
+                break;
+            }
+
+            statics.append(text, position, start - position);
+            std::string name = text.substr(start + 1, stop - start - 1);
+            bool        escape = text[start] == '\x01';
+            if (escape && name.size() >= 5 && name.compare(name.size() - 5, 5, "&amp;") == 0)
+            {
+                name.resize(name.size() - 5);
+            }
+            else if (escape && !name.empty() && name.back() == '&')
+            {
+                name.pop_back();
+                escape = false;
+            }
+            const auto  inserted = indices.emplace(std::move(name), indices.size());
+            holes.push_back({statics.size(), inserted.first->second, escape});
+            position = stop + 1;
+        }
+        statics.shrink_to_fit();
+    }
+
+    size_t  Holes() const {return indices.size();}
+
+    size_t  Index(const std::string &name) const
+    /// Index of the value filling the placeholder called name.
+    {
+        const auto  ii = indices.find(name);
+        if (ii == indices.end())
+        {
+            throw std::out_of_range("simple_svg::Template: no placeholder " + name);
+        }
+        return ii->second;
+    }
+
+    void    Fill(Sink &sink, const std::vector<std::string_view> &values) const
+    /// Writes the document with values[Index(name)] in place of each
+    /// placeholder called name.
+    {
+        if (values.size() < Holes())
+        {
+            throw std::invalid_argument("simple_svg::Template: too few values");
+        }
+
+        size_t  offset{0};
+        for (const auto &hole : holes)
+        {
+            sink.Write(statics.data() + offset, hole.offset - offset);
+            const std::string_view  value = values[hole.index];
+            if (hole.escape)
+            {
+                sink.WriteEscaped(value.data(), value.size());
+            }
+            else
+            {
+                sink.Write(value.data(), value.size());
+            }
+            offset = hole.offset;
+        }
+        sink.Write(statics.data() + offset, statics.size() - offset);
+    }
+
+    void    Fill(std::string &text, const std::vector<std::string_view> &values) const
+    /// Replaces text by the filled in document, reusing its storage.
+    {
+        size_t  size = statics.size();
+        for (const auto &hole : holes)
+        {
+            size += values.size() > hole.index ? values[hole.index].size() : 0;
+        }
+
+        text.clear();
+        text.reserve(size);
+        StringSink  sink(text);
+        Fill(sink, values);
+    }
+};
+
+} // namespace simple_svg
@@ -6,18 +6,317 @@
 #include <sstream>
 #include <memory>
 #include <cmath>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+#include <limits>
+#include <cctype>
+#include <mutex>
+#include <map>
+#include <unordered_set>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMPLE_SVG_SSE2
+#include <immintrin.h>
+#endif
+#if defined(__SSSE3__)
+#define SIMPLE_SVG_SSSE3
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 namespace simple_svg
 {
 
 //-----------------------------------------------------------------------------
+inline size_t format_number(char *buffer, size_t size, double value)
+/// Formats value as std::ostream does by default (%g, 6 significant digits)
+/// and returns the number of characters written.
+{
+#if defined(__cpp_lib_to_chars)
+    return static_cast<size_t>(std::to_chars(buffer, buffer + size, value, std::chars_format::general, 6).ptr - buffer);
+#else
+    return static_cast<size_t>(std::snprintf(buffer, size, "%g", value));
+#endif
+}
+
+inline const char* parse_number(const char *first, const char *last, double &value)
+/// Parses a number, independent of locale, and returns the position after it
+/// or first if there is none.
+{
+    const char  *start = (first != last && *first == '+') ? first + 1 : first;
+#if defined(__cpp_lib_to_chars)
+    const auto  result = std::from_chars(start, last, value);
+    return result.ec == std::errc() ? result.ptr : first;
+#else
+    std::istringstream  stream(std::string(start, last));
+    stream.imbue(std::locale::classic());
+    if (!(stream >> value))
+    {
+        return first;
+    }
+    return stream.eof() ? last : start + static_cast<size_t>(stream.tellg());
+#endif
+}
+
+inline double to_number(const std::string &text, double fallback = 0.0)
+{
+    double  value{};
+    const char  *first = text.data();
+    while (first != text.data() + text.size() && std::isspace(static_cast<unsigned char>(*first)))
+    {
+        ++first;
+    }
+    return parse_number(first, text.data() + text.size(), value) != first ? value : fallback;
+}
+
 inline std::string to_string(double value)
 {
-    std::stringstream   s;
-    s << value;
-    return s.str();
+    char    buffer[32];
+    return std::string(buffer, format_number(buffer, sizeof(buffer), value));
+}
+
+inline size_t heap_bytes(const std::string &text)
+/// Bytes allocated by text, 0 if it is held in the small string buffer
+/// inside the object.
+{
+    const char  *object = reinterpret_cast<const char*>(&text);
+    const bool  inside = text.data() >= object && text.data() < object + sizeof(text);
+    return inside ? 0 : text.capacity() + 1;
+}
+
+//-----------------------------------------------------------------------------
+inline unsigned count_trailing_zeros(uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long   index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+inline bool needs_escape(char c)
+{
+    return c == '&' || c == '<' || c == '>' || c == '"';
+}
+
+inline size_t escape_scan(const char *data, size_t size)
+/// Returns the position of the first character in data that must be escaped
+/// in XML text and attribute values, or size if there is none. Scans 32 or 16
+/// bytes at a time when AVX2 or SSE2 is available.
+{
+    size_t  i{0};
+#if defined(__AVX2__)
+    const __m256i   amp32 = _mm256_set1_epi8('&');
+    const __m256i   lt32 = _mm256_set1_epi8('<');
+    const __m256i   gt32 = _mm256_set1_epi8('>');
+    const __m256i   quot32 = _mm256_set1_epi8('"');
+    for (; i + 32 <= size; i += 32)
+    {
+        const __m256i   chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const __m256i   hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, amp32), _mm256_cmpeq_epi8(chunk, lt32)),
+                                               _mm256_or_si256(_mm256_cmpeq_epi8(chunk, gt32), _mm256_cmpeq_epi8(chunk, quot32)));
+        const uint32_t  mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+        if (mask != 0)
+        {
+            return i + count_trailing_zeros(mask);
+        }
+    }
+#endif
+#if defined(SIMPLE_SVG_SSE2)
+    const __m128i   amp = _mm_set1_epi8('&');
+    const __m128i   lt = _mm_set1_epi8('<');
+    const __m128i   gt = _mm_set1_epi8('>');
+    const __m128i   quot = _mm_set1_epi8('"');
+    for (; i + 16 <= size; i += 16)
+    {
+        const __m128i   chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const __m128i   hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, amp), _mm_cmpeq_epi8(chunk, lt)),
+                                            _mm_or_si128(_mm_cmpeq_epi8(chunk, gt), _mm_cmpeq_epi8(chunk, quot)));
+        const uint32_t  mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+        if (mask != 0)
+        {
+            return i + count_trailing_zeros(mask);
+        }
+    }
+#endif
+    for (; i < size; ++i)
+    {
+        if (needs_escape(data[i]))
+        {
+            return i;
+        }
+    }
+    return size;
+}
+
+constexpr size_t base64_size(size_t size)
+{
+    return (size + 2) / 3 * 4;
+}
+
+inline size_t base64_encode(const uint8_t *data, size_t size, char *text)
+/// Writes data base64 encoded, with padding, into text, which must hold
+/// base64_size(size) characters, and returns that size. Encodes 12 bytes at a
+/// time when SSSE3 is available.
+{
+    static const char   alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char                *out = text;
+    size_t              i{0};
+#if defined(SIMPLE_SVG_SSSE3)
+    // http://0x80.pl/notesen/2016-01-12-sse-base64-encoding.html: spread
+    // every 3 bytes over 4 bytes, split them into 6 bit indices by two
+    // multiplies and map the indices to characters by a per range offset.
+    const __m128i   spread = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m128i   offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                            '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    for (; i + 16 <= size; i += 12)
+    {
+        const __m128i   bytes = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), spread);
+        const __m128i   high = _mm_mulhi_epu16(_mm_and_si128(bytes, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        const __m128i   low = _mm_mullo_epi16(_mm_and_si128(bytes, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        const __m128i   indices = _mm_or_si128(high, low);
+
+        __m128i         range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, range)));
+        out += 16;
+    }
+#endif
+    for (; i + 3 <= size; i += 3)
+    {
+        const uint32_t  v = static_cast<uint32_t>(data[i]) << 16 | static_cast<uint32_t>(data[i + 1]) << 8 | data[i + 2];
+        out[0] = alphabet[v >> 18];
+        out[1] = alphabet[(v >> 12) & 63];
+        out[2] = alphabet[(v >> 6) & 63];
+        out[3] = alphabet[v & 63];
+        out += 4;
+    }
+    if (i < size)
+    {
+        const uint32_t  v = static_cast<uint32_t>(data[i]) << 16 | (i + 1 < size ? static_cast<uint32_t>(data[i + 1]) << 8 : 0);
+        out[0] = alphabet[v >> 18];
+        out[1] = alphabet[(v >> 12) & 63];
+        out[2] = i + 1 < size ? alphabet[(v >> 6) & 63] : '=';
+        out[3] = '=';
+        out += 4;
+    }
+    return static_cast<size_t>(out - text);
 }
 
+//-----------------------------------------------------------------------------
+class Sink
+{
+    // Destination of serialized output. Elements write themselves piece by
+    // piece into a sink, so no intermediate strings are built on the way.
+public:
+    virtual ~Sink() {}
+
+    virtual void    Write(const char *data, size_t size) = 0;
+
+    virtual bool    Skip(size_t /*size*/)
+    /// Accounts for size bytes of output without them, e.g. of data costly
+    /// to produce. Returns false for sinks that need the bytes written.
+    {
+        return false;
+    }
+
+    Sink&   operator<<(char c) {Write(&c, 1); return *this;}
+    Sink&   operator<<(const char *text) {Write(text, std::strlen(text)); return *this;}
+    Sink&   operator<<(const std::string &text) {Write(text.data(), text.size()); return *this;}
+    Sink&   operator<<(double value)
+    {
+        char    buffer[32];
+        Write(buffer, format_number(buffer, sizeof(buffer), value));
+        return *this;
+    }
+
+    void    WriteEscaped(const char *data, size_t size)
+    /// Writes data with & < > " replaced by entities, copying the clean runs
+    /// between them in one piece.
+    {
+        while (size != 0)
+        {
+            const size_t    clean = escape_scan(data, size);
+            Write(data, clean);
+            if (clean == size)
+            {
+                break;
+            }
+
+            switch (data[clean])
+            {
+            case '&':   Write("&amp;", 5);  break;
+            case '<':   Write("&lt;", 4);   break;
+            case '>':   Write("&gt;", 4);   break;
+            default:    Write("&quot;", 6); break;
+            }
+            data += clean + 1;
+            size -= clean + 1;
+        }
+    }
+
+    void    WriteEscaped(const std::string &text) {WriteEscaped(text.data(), text.size());}
+};
+
+class StringSink : public Sink
+{
+    std::string &text;
+public:
+    StringSink(std::string &text) : text(text) {}
+
+    virtual void    Write(const char *data, size_t size) override {text.append(data, size);}
+};
+
+class StreamSink : public Sink
+{
+    std::ostream    &stream;
+public:
+    StreamSink(std::ostream &stream) : stream(stream) {}
+
+    virtual void    Write(const char *data, size_t size) override {stream.write(data, static_cast<std::streamsize>(size));}
+};
+
+class CountingSink : public Sink
+{
+    // Only counts the bytes written, @see Base::TextSize().
+    size_t  count{0};
+public:
+    size_t  Count() const {return count;}
+
+    virtual void    Write(const char *, size_t size) override {count += size;}
+    virtual bool    Skip(size_t size) override {count += size; return true;}
+};
+
+class BufferSink : public Sink
+{
+    // Writes into a caller supplied buffer, e.g. one allocated from
+    // Base::TextSize() or a memory mapped output file.
+    char    *buffer;
+    size_t  capacity;
+    size_t  size{0};
+public:
+    BufferSink(char *buffer, size_t capacity) : buffer(buffer), capacity(capacity) {}
+
+    size_t  Size() const {return size;}
+
+    virtual void    Write(const char *data, size_t length) override
+    {
+        if (length > capacity - size)
+        {
+            throw std::length_error("simple_svg::BufferSink: buffer too small");
+        }
+        std::memcpy(buffer + size, data, length);
+        size += length;
+    }
+};
+
 //-----------------------------------------------------------------------------
 class Point
 {
@@ -25,6 +324,8 @@ class Point
     double  y{0.0};
 
 public:
+    static constexpr double tolerance{1e-3};    ///< distance below which coordinates are equal.
+
     Point() = default;
     Point(const Point&) = default;
     Point(Point&&) = default;
@@ -36,15 +337,32 @@ public:
     double  X() const {return x;}
     double  Y() const {return y;}
 
+    void    Serialize(Sink &sink) const
+    {
+        sink << x << ',' << y;
+    }
+
     std::string ToText() const
     {
-        std::stringstream stream;
-        stream << x << ',' << y;
-        return stream.str();
+        std::string text;
+        StringSink  sink(text);
+        Serialize(sink);
+        return text;
     }
 
     double  Length() const {return std::sqrt(x*x + y*y);}
 
+    bool    Between(const Point &a, const Point &b) const
+    /// Whether the point lies on the segment from a to b, within tolerance.
+    {
+        const double    ab_x = b.x - a.x;
+        const double    ab_y = b.y - a.y;
+        const double    length = std::sqrt(ab_x*ab_x + ab_y*ab_y);
+        const double    along = (x - a.x) * ab_x + (y - a.y) * ab_y;
+        return length >= tolerance && along >= 0.0 && along <= length * length
+            && std::fabs((x - a.x) * ab_y - (y - a.y) * ab_x) <= tolerance * length;
+    }
+
     friend std::ostream& operator<<(std::ostream &stream, const Point &point)
     {
         return stream << point.ToText();
@@ -56,832 +374,4194 @@ public:
     friend  Point   operator*(const Point &a, double factor)  {return {a.x * factor, a.y * factor};}
     friend  Point   operator*(double factor, const Point &a)  {return a * factor;}
     friend  double  operator*(const Point &a, const Point &b) {return a.x * b.x + a.y * b.y;}
-    friend  bool    operator==(const Point &a, const Point &b) {return std::fabs(a.x - b.x) < 1e-3 && std::fabs(a.y - b.y) < 1e-3;}
+    friend  bool    operator==(const Point &a, const Point &b) {return std::fabs(a.x - b.x) < tolerance && std::fabs(a.y - b.y) < tolerance;}
 };
 
 //-----------------------------------------------------------------------------
-class Attribute
+enum class Storage
 {
-    std::string name;
-    std::string value;
-public:
-    Attribute() = default;
-    Attribute(const Attribute&) = default;
-    Attribute(Attribute&&) = default;
-    Attribute& operator=(const Attribute&) = default;
-    Attribute& operator=(Attribute&&) = default;
+    Double,     ///< 8 bytes per coordinate, written with 6 significant digits.
+    Float,      ///< 4 bytes, written with the fewest digits reading back the same float.
+    Fixed,      ///< 4 bytes, integers in units of 10^-decimals, written with up to decimals digits.
+    Exact       ///< 8 bytes, written with the fewest digits reading back the same double, e.g. for geometry read from a file.
+};
 
-    Attribute(std::string name, std::string value) : name(name), value(value) {}
-    Attribute(std::string name, double value) : name(name), value(to_string(value)) {}
-    Attribute(std::string name, int32_t value) : name(name), value(std::to_string(value)) {}
-    Attribute(std::string name, bool value) : name(name), value(value ? "true" : "false") {}
+class Coordinates
+{
+    // Sequence of coordinates stored as doubles, floats or 32 bit fixed point
+    // integers, chosen at run time. Only the vector of the chosen storage is
+    // used; values are converted when the storage changes.
+    Storage                 storage{Storage::Double};
+    int                     decimals{2};
+    double                  scale{100.0};
+    std::vector<double>     doubles;
+    std::vector<float>      floats;
+    std::vector<int32_t>    fixed;
+
+    int32_t ToFixed(double value) const
+    {
+        const double    scaled = std::round(value * scale);
+        if (!(std::fabs(scaled) <= 2147483647.0))
+        {
+            throw std::out_of_range("simple_svg::Coordinates: " + to_string(value) + " out of fixed point range");
+        }
+        return static_cast<int32_t>(scaled);
+    }
 
-    std::string Name() const {return name;}
-    std::string Value() const {return value;}
-    void        Value(std::string value) {this->value = value;}
+public:
+    Storage Kind() const {return storage;}
+    int     Decimals() const {return decimals;}
 
-    std::string ToText() const
+    size_t  Size() const
     {
-        return name + "=\"" + value + "\"";
+        switch (storage)
+        {
+        case Storage::Float:    return floats.size();
+        case Storage::Fixed:    return fixed.size();
+        default:                return doubles.size();
+        }
     }
 
-    friend std::ostream& operator<<(std::ostream &stream, const Attribute &attribute)
+    size_t  Bytes() const
+    /// Allocated storage in bytes.
     {
-        return stream << attribute.ToText();
+        return doubles.capacity() * sizeof(double) + floats.capacity() * sizeof(float) + fixed.capacity() * sizeof(int32_t);
     }
-};
 
-class Transform
-{
-    // https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/transform
-    std::vector<std::string>    transforms;
-public:
-    Transform&  matrix(double a, double b, double c, double d, double e, double f)
+    double  At(size_t i) const
     {
-        std::stringstream   stream;
-        stream << "matrix(" << a << " " << b << " " << c << " " << d << " " << e << " " << f << ')';
-        transforms.push_back(stream.str());
+        switch (storage)
+        {
+        case Storage::Float:    return floats[i];
+        case Storage::Fixed:    return fixed[i] / scale;
+        default:                return doubles[i];
+        }
+    }
 
-        return *this;
+    void    Set(size_t i, double value)
+    {
+        switch (storage)
+        {
+        case Storage::Float:    floats[i] = static_cast<float>(value); break;
+        case Storage::Fixed:    fixed[i] = ToFixed(value); break;
+        default:                doubles[i] = value; break;
+        }
     }
 
-    Transform&  Translate(double dx, double dy=0.0)
+    void    Add(double value)
     {
-        std::stringstream   stream;
-        stream << "translate(" << dx << " " << dy << ')';
-        transforms.push_back(stream.str());
+        switch (storage)
+        {
+        case Storage::Float:    floats.push_back(static_cast<float>(value)); break;
+        case Storage::Fixed:    fixed.push_back(ToFixed(value)); break;
+        default:                doubles.push_back(value); break;
+        }
+    }
 
-        return *this;
+    void    Add(const double *values, size_t count)
+    /// Adds all values or, if one is out of fixed point range, none.
+    {
+        if (storage == Storage::Fixed)
+        {
+            std::for_each(values, values + count, [this](double value){ToFixed(value);});
+        }
+        Reserve(Size() + count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            Add(values[i]);
+        }
     }
 
-    Transform&  Translate(const Point &dp)
+    const void* Data() const
+    /// The values in their storage representation, ValueBytes() each.
     {
-        return Scale(dp.X(), dp.Y());
+        switch (storage)
+        {
+        case Storage::Float:    return floats.data();
+        case Storage::Fixed:    return fixed.data();
+        default:                return doubles.data();
+        }
     }
 
-    Transform&  Scale(double scale_x, double scale_y)
+    size_t  ValueBytes() const {return storage == Storage::Double || storage == Storage::Exact ? sizeof(double) : 4;}
+
+    void    Assign(Storage storage, int decimals, const void *data, size_t count)
+    /// Replaces the values by count values in the representation of storage,
+    /// as given by Data().
     {
-        std::stringstream   stream;
-        stream << "scale(" << " " << scale_x << " " << scale_y << ')';
-        transforms.push_back(stream.str());
+        Clear();
+        Store(storage, decimals);
+        switch (storage)
+        {
+        case Storage::Float:    floats.resize(count); break;
+        case Storage::Fixed:    fixed.resize(count); break;
+        default:                doubles.resize(count); break;
+        }
+        if (count != 0)
+        {
+            std::memcpy(const_cast<void*>(Data()), data, count * ValueBytes());
+        }
+    }
 
-        return *this;
+    void    Copy(size_t first, size_t count, double *values) const
+    /// Reads count values starting at first.
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            values[i] = At(first + i);
+        }
     }
 
-    Transform&  Scale(const Point &scale)
+    void    Reserve(size_t size)
     {
-        return Scale(scale.X(), scale.Y());
+        switch (storage)
+        {
+        case Storage::Float:    floats.reserve(size); break;
+        case Storage::Fixed:    fixed.reserve(size); break;
+        default:                doubles.reserve(size); break;
+        }
     }
 
-    Transform&  Scale(double scale_x)
+    void    Clear()
     {
-        return Scale(scale_x, scale_x);
+        doubles.clear();
+        floats.clear();
+        fixed.clear();
     }
 
-    Transform&  Rotate(double angle, double about_x=0.0, double about_y=0.0)
+    void    Truncate(size_t size)
+    /// Keeps the first size values.
     {
-        std::stringstream   stream;
-        stream << "rotate(" << angle << " " << about_x << " " << about_y << ')';
-        transforms.push_back(stream.str());
+        if (size < Size())
+        {
+            doubles.resize(std::min(size, doubles.size()));
+            floats.resize(std::min(size, floats.size()));
+            fixed.resize(std::min(size, fixed.size()));
+        }
+    }
 
-        return *this;
+    void    ShrinkToFit()
+    {
+        doubles.shrink_to_fit();
+        floats.shrink_to_fit();
+        fixed.shrink_to_fit();
     }
 
-    Transform&  Rotate(double angle, const Point about)
+    void    Swap(Coordinates &other)
     {
-        return Rotate(angle, about.X(), about.Y());
+        std::swap(storage, other.storage);
+        std::swap(decimals, other.decimals);
+        std::swap(scale, other.scale);
+        doubles.swap(other.doubles);
+        floats.swap(other.floats);
+        fixed.swap(other.fixed);
     }
 
-    Transform&  SkewX(double skew_x)
+    void    Store(Storage storage, int decimals = 2)
+    /// Converts the values to storage, decimals being the digits kept after
+    /// the decimal point by Storage::Fixed (0 to 9).
     {
-        std::stringstream   stream;
-        stream << "skewX(" << " " << skew_x << ')';
-        transforms.push_back(stream.str());
+        if (decimals < 0 || decimals > 9)
+        {
+            throw std::invalid_argument("simple_svg::Coordinates: decimals must be 0 to 9");
+        }
+        if (storage == this->storage && (storage != Storage::Fixed || decimals == this->decimals))
+        {
+            return;
+        }
 
-        return *this;
+        Coordinates converted;
+        converted.storage = storage;
+        converted.decimals = decimals;
+        converted.scale = std::pow(10.0, decimals);
+        converted.Reserve(Size());
+        for (size_t i = 0; i < Size(); ++i)
+        {
+            converted.Add(At(i));
+        }
+        Swap(converted);
     }
 
-    Transform&  SkewY(double skew_y)
+    void    Write(Sink &sink, size_t i) const
+    {
+        switch (storage)
+        {
+        case Storage::Float:    WriteFloat(sink, floats[i]); break;
+        case Storage::Fixed:    WriteFixed(sink, fixed[i]); break;
+        case Storage::Exact:    WriteExact(sink, doubles[i]); break;
+        default:                sink << doubles[i]; break;
+        }
+    }
+
+    void    WriteValue(Sink &sink, double value) const
+    /// Writes value as it would be written after storing it.
     {
-        std::stringstream   stream;
-        stream << "skewY(" << " " << skew_y << ')';
-        transforms.push_back(stream.str());
+        switch (storage)
+        {
+        case Storage::Float:    WriteFloat(sink, static_cast<float>(value)); break;
+        case Storage::Fixed:    WriteFixed(sink, ToFixed(value)); break;
+        case Storage::Exact:    WriteExact(sink, value); break;
+        default:                sink << value; break;
+        }
+    }
 
-        return *this;
+private:
+    static void WriteExact(Sink &sink, double value)
+    {
+        char    buffer[32];
+#if defined(__cpp_lib_to_chars)
+        sink.Write(buffer, static_cast<size_t>(std::to_chars(buffer, buffer + sizeof(buffer), value).ptr - buffer));
+#else
+        sink.Write(buffer, static_cast<size_t>(std::snprintf(buffer, sizeof(buffer), "%.17g", value)));
+#endif
     }
 
-    Attribute   AsAttribute() const
+    static void WriteFloat(Sink &sink, float value)
     {
-        std::stringstream   stream;
+        char    buffer[32];
+#if defined(__cpp_lib_to_chars)
+        sink.Write(buffer, static_cast<size_t>(std::to_chars(buffer, buffer + sizeof(buffer), value).ptr - buffer));
+#else
+        sink.Write(buffer, static_cast<size_t>(std::snprintf(buffer, sizeof(buffer), "%.9g", value)));
+#endif
+    }
 
-        for (size_t i = transforms.size(); i != 0; --i)
-        //for (const auto &t : transforms)
+    void    WriteFixed(Sink &sink, int64_t value) const
+    {
+        // integer and fraction digits written backwards, trailing zeros dropped.
+        char        buffer[32];
+        uint64_t    magnitude = static_cast<uint64_t>(value < 0 ? -value : value);
+        char        *end = buffer + sizeof(buffer);
+        char        *p = end;
+        bool        digits{false};
+        for (int k = 0; k < decimals; ++k, magnitude /= 10)
+        {
+            const char  digit = static_cast<char>('0' + magnitude % 10);
+            if (digits || digit != '0')
+            {
+                *--p = digit;
+                digits = true;
+            }
+        }
+        if (digits)
         {
-            stream << transforms[i-1] << " ";
+            *--p = '.';
         }
-
-        return {"transform", stream.str()};
+        do
+        {
+            *--p = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude != 0);
+        if (value < 0)
+        {
+            *--p = '-';
+        }
+        sink.Write(p, static_cast<size_t>(end - p));
     }
 };
 
 //-----------------------------------------------------------------------------
-class Base
+class Attribute
 {
-    std::string             tag;
-    std::vector<Attribute>  attributes;
-
-protected:
-    virtual std::string Extras() const {return {};}
-
+    std::string name;
+    std::string value;
+    bool        escape{true};   ///< false for values known not to need XML escaping.
 public:
-    Base() = default;
-    Base(const Base&) = default;
-    Base(Base&&) = default;
-    Base& operator=(const Base&) = default;
-    Base& operator=(Base&&) = default;
+    Attribute() = default;
+    Attribute(const Attribute&) = default;
+    Attribute(Attribute&&) = default;
+    Attribute& operator=(const Attribute&) = default;
+    Attribute& operator=(Attribute&&) = default;
 
-    Base(const std::string &tag) : tag(tag) {}
-    Base(const std::string &tag, const std::vector<Attribute> &attributes)
-        : tag(tag),
-          attributes(attributes)
-    {}
+    Attribute(std::string name, std::string value, bool escape = true) : name(name), value(value), escape(escape) {}
+    Attribute(std::string name, double value) : name(name), value(to_string(value)), escape(false) {}
+    Attribute(std::string name, int32_t value) : name(name), value(std::to_string(value)), escape(false) {}
+    Attribute(std::string name, bool value) : name(name), value(value ? "true" : "false"), escape(false) {}
 
-    virtual ~Base() {}
+    std::string Name() const {return name;}
+    std::string Value() const {return value;}
+    void        Value(std::string value) {this->value = value;}
+    bool        Escape() const {return escape;}
+    void        Escape(bool escape) {this->escape = escape;}
 
-    std::string     Tag() const {return tag;}
-    const auto&     Attributes() const {return attributes;}
+    size_t      HeapBytes() const {return heap_bytes(name) + heap_bytes(value);}
+    void        ShrinkToFit() {name.shrink_to_fit(); value.shrink_to_fit();}
 
-    Base&   AddAttribute(const Attribute &attribute)
+    void    Serialize(Sink &sink) const
     {
-        auto ii = std::find_if(attributes.begin(), attributes.end(), [attribute](const auto &a){return a.Name().compare(attribute.Name())==0;});
-        if (ii != attributes.end())
+        sink << name << "=\"";
+        if (escape)
         {
-            ii->Value(attribute.Value());
+            sink.WriteEscaped(value);
         }
         else
         {
-            attributes.push_back(attribute);
+            sink << value;
         }
-        return *this;
+        sink << '"';
     }
 
-    Base&   Id(const std::string &id)
+    std::string ToText() const
     {
-        return AddAttribute({"id", id});
+        std::string text;
+        StringSink  sink(text);
+        Serialize(sink);
+        return text;
     }
 
-    Base&   Class(const std::string &class_name)
+    friend std::ostream& operator<<(std::ostream &stream, const Attribute &attribute)
     {
-        return AddAttribute({"class", class_name});
+        return stream << attribute.ToText();
     }
+};
 
-    Base&   Stroke(const std::string &stroke)
-    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/stroke
+class Transform
+{
+    // https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/transform
+    // Composed affine matrix | a c e |
+    //                        | b d f |
+    // every operation added applies after the ones added before it.
+    double  a{1.0};
+    double  b{0.0};
+    double  c{0.0};
+    double  d{1.0};
+    double  e{0.0};
+    double  f{0.0};
+
+    static bool Near(double x, double y) {return std::fabs(x - y) <= 1e-9 * (1.0 + std::fabs(x) + std::fabs(y));}
+
+    static std::string Function(const char *name, std::initializer_list<double> values)
     {
-        return AddAttribute({"stroke", stroke});
+        std::string text(name);
+        text += '(';
+        for (auto ii = values.begin(); ii != values.end(); ++ii)
+        {
+            if (ii != values.begin())
+            {
+                text += ' ';
+            }
+            text += to_string(*ii);
+        }
+        text += ')';
+        return text;
     }
 
-    Base&   StrokeWidth(const double &stroke_width)
-    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/stroke-width
+    Transform&  Then(const Transform &next)
     {
-        return AddAttribute({"stroke-width", stroke_width});
+        *this = next * *this;
+        return *this;
     }
 
-    Base&   StrokeOpacity(const double &stroke_opacity)
-    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/stroke-opacity
+public:
+    Transform() = default;
+    Transform(const Transform&) = default;
+    Transform(Transform&&) = default;
+    Transform& operator=(const Transform&) = default;
+    Transform& operator=(Transform&&) = default;
+
+    Transform(double a, double b, double c, double d, double e, double f)
+        : a(a), b(b), c(c), d(d), e(e), f(f)
+    {}
+
+    double  A() const {return a;}
+    double  B() const {return b;}
+    double  C() const {return c;}
+    double  D() const {return d;}
+    double  E() const {return e;}
+    double  F() const {return f;}
+
+    Transform&  matrix(double a, double b, double c, double d, double e, double f)
     {
-        return AddAttribute({"stroke-opacity", stroke_opacity});
+        return Then({a, b, c, d, e, f});
     }
 
-    Base&   Fill(const std::string &fill)
-    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/fill
+    Transform&  Translate(double dx, double dy=0.0)
     {
-        return AddAttribute({"fill", fill});
+        return Then({1.0, 0.0, 0.0, 1.0, dx, dy});
     }
 
-    Base&   FillOpacity(const double &fill_opacity)
-    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/fill-opacity
+    Transform&  Translate(const Point &dp)
     {
-        return AddAttribute({"fill-opacity", fill_opacity});
+        return Translate(dp.X(), dp.Y());
     }
 
-    Base&   Opacity(const double &opacity)
-    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/opacity
+    Transform&  Scale(double scale_x, double scale_y)
     {
-        return AddAttribute({"opacity", opacity});
+        return Then({scale_x, 0.0, 0.0, scale_y, 0.0, 0.0});
     }
 
-    Base&   Transform(const Transform &transform)
+    Transform&  Scale(const Point &scale)
     {
-        return AddAttribute(transform.AsAttribute());
+        return Scale(scale.X(), scale.Y());
     }
 
-    virtual std::string ToText() const
+    Transform&  Scale(double scale_x)
     {
-        std::ostringstream  stream;
-        stream << "<" << tag;
+        return Scale(scale_x, scale_x);
+    }
 
-        stream << ' ' << Extras();
+    Transform&  Rotate(double angle, double about_x=0.0, double about_y=0.0)
+    /// Rotates angle degrees about (about_x, about_y).
+    {
+        const double    radians = angle * std::acos(-1.0) / 180.0;
+        const double    cos = std::fabs(std::cos(radians)) < 1e-15 ? 0.0 : std::cos(radians);
+        const double    sin = std::fabs(std::sin(radians)) < 1e-15 ? 0.0 : std::sin(radians);
 
-        for (const auto &attribute : attributes)
-        {
-            stream << ' ' << attribute;
-        }
-        stream << "/>";
+        Translate(-about_x, -about_y);
+        Then({cos, sin, -sin, cos, 0.0, 0.0});
+        return Translate(about_x, about_y);
+    }
 
-        return stream.str();
+    Transform&  Rotate(double angle, const Point about)
+    {
+        return Rotate(angle, about.X(), about.Y());
     }
 
-    friend std::ostream& operator<<(std::ostream &stream, const Base &base)
+    Transform&  SkewX(double skew_x)
     {
-        return stream << base.ToText();
+        return Then({1.0, 0.0, std::tan(skew_x * std::acos(-1.0) / 180.0), 1.0, 0.0, 0.0});
     }
-};
 
+    Transform&  SkewY(double skew_y)
+    {
+        return Then({1.0, std::tan(skew_y * std::acos(-1.0) / 180.0), 0.0, 1.0, 0.0, 0.0});
+    }
 
-class Rect : public Base
-{
-    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/rect
-public:
-    Rect(const Rect&) = default;
-    Rect(Rect&&) = default;
-    Rect& operator=(const Rect&) = default;
-    Rect& operator=(Rect&&) = default;
+    friend Transform    operator*(const Transform &m, const Transform &n)
+    /// The transform applying n first and then m.
+    {
+        return {m.a * n.a + m.c * n.b,
+                m.b * n.a + m.d * n.b,
+                m.a * n.c + m.c * n.d,
+                m.b * n.c + m.d * n.d,
+                m.a * n.e + m.c * n.f + m.e,
+                m.b * n.e + m.d * n.f + m.f};
+    }
 
-    Rect() : Base("rect") {}
-    Rect(double x, double y, double w, double h)
-        : Base("rect", {{"x", x}, {"y", y}, {"width", w}, {"height", h}})
-    {}
-    Rect(double w, double h)
-        : Base("rect", {{"width", w}, {"height", h}})
-    {}
-    Rect(const Point &from, const Point &to)
-        : Base("rect", {{"x", from.X()}, {"y", from.Y()}, {"width", to.X() - from.X()}, {"height", to.Y() - from.Y()}})
-    {}
-    virtual ~Rect() {}
-};
+    Point   Apply(const Point &p) const {return {a * p.X() + c * p.Y() + e, b * p.X() + d * p.Y() + f};}
+    Point   ApplyLinear(const Point &p) const {return {a * p.X() + c * p.Y(), b * p.X() + d * p.Y()};}
 
-class PolyBase : public Base
-{
-    std::vector<Point> points;
+    double  Determinant() const {return a * d - b * c;}
+    bool    IsIdentity() const {return Near(a, 1.0) && Near(b, 0.0) && Near(c, 0.0) && Near(d, 1.0) && Near(e, 0.0) && Near(f, 0.0);}
+    bool    IsTranslation() const {return Near(a, 1.0) && Near(b, 0.0) && Near(c, 0.0) && Near(d, 1.0);}
+    bool    IsAxisAligned() const {return (Near(b, 0.0) && Near(c, 0.0)) || (Near(a, 0.0) && Near(d, 0.0));}
 
-protected:
-    virtual std::string Extras() const override
+    bool    IsSimilarity(double &scale) const
+    /// Returns whether the transform preserves shapes (rotation, reflection,
+    /// uniform scale and translation), with scale set to its scale factor.
     {
-        std::ostringstream  stream;
-
-        for (const auto &p : points)
-        {
-            stream << p << " ";
-        }
-
-        return Attribute("points", stream.str()).ToText();
+        scale = std::sqrt(std::fabs(Determinant()));
+        return Near(a * a + b * b, c * c + d * d) && Near(a * c + b * d, 0.0);
     }
 
-public:
-    PolyBase(std::string tag) : Base(tag) {}
-    PolyBase(std::string tag, const std::vector<Point> &points)
-        : Base(tag),
-          points(points)
-    {}
-    virtual ~PolyBase() override {}
-
-    PolyBase&   Add(const Point &point)
+    double  Rotation() const
+    /// Angle in degrees the x axis is rotated by.
     {
-        points.push_back(point);
-        return *this;
+        return std::atan2(b, a) * 180.0 / std::acos(-1.0);
     }
 
-    PolyBase&   Add(double x, double y)
+    static Transform    Parse(const std::string &text)
+    /// Parses an SVG transform list, e.g. "translate(10 20) rotate(45)".
     {
-        return Add({x, y});
+        Transform   transform;
+
+        const char  *current = text.data();
+        const char  *end = text.data() + text.size();
+        auto        skip = [&current, end](){while (current != end && (std::isspace(static_cast<unsigned char>(*current)) || *current == ',')) ++current;};
+        for (skip(); current != end; skip())
+        {
+            const char  *name = current;
+            while (current != end && std::isalpha(static_cast<unsigned char>(*current)))
+            {
+                ++current;
+            }
+            const std::string   function(name, current);
+            skip();
+            if (function.empty() || current == end || *current != '(')
+            {
+                throw std::invalid_argument("simple_svg::Transform: cannot parse \"" + text + "\"");
+            }
+
+            double  v[6]{};
+            size_t  count{0};
+            for (++current, skip(); current != end && *current != ')'; skip())
+            {
+                double      value{};
+                const char  *next = parse_number(current, end, value);
+                if (next == current || count == 6)
+                {
+                    throw std::invalid_argument("simple_svg::Transform: cannot parse \"" + text + "\"");
+                }
+                v[count++] = value;
+                current = next;
+            }
+            if (current == end)
+            {
+                throw std::invalid_argument("simple_svg::Transform: cannot parse \"" + text + "\"");
+            }
+            ++current;
+
+            Transform   step;
+            if      (function == "matrix" && count == 6)    step.matrix(v[0], v[1], v[2], v[3], v[4], v[5]);
+            else if (function == "translate" && count >= 1) step.Translate(v[0], v[1]);
+            else if (function == "scale" && count == 1)     step.Scale(v[0]);
+            else if (function == "scale" && count == 2)     step.Scale(v[0], v[1]);
+            else if (function == "rotate" && count >= 1)    step.Rotate(v[0], v[1], v[2]);
+            else if (function == "skewX" && count == 1)     step.SkewX(v[0]);
+            else if (function == "skewY" && count == 1)     step.SkewY(v[0]);
+            else
+            {
+                throw std::invalid_argument("simple_svg::Transform: cannot parse \"" + text + "\"");
+            }
+
+            transform = transform * step;
+        }
+
+        return transform;
     }
 
-    PolyBase&   Add(const std::vector<Point> &points)
+    Attribute   AsAttribute() const
+    /// The shortest of the equivalent transform lists, empty for the identity.
     {
-        for (const auto &p : points)
+        if (IsIdentity())
         {
-            Add(p);
+            return {"transform", std::string(), false};
         }
 
-        return *this;
-    }
-};
+        std::vector<std::string>    candidates{Function("matrix", {a, b, c, d, e, f})};
+        const std::string           translate = Near(f, 0.0) ? Function("translate", {e}) : Function("translate", {e, f});
+        const bool                  translated = !Near(e, 0.0) || !Near(f, 0.0);
 
-class Polyline : public PolyBase
-{
-    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/polyline
-public:
-    Polyline(const Polyline&) = default;
-    Polyline(Polyline&&) = default;
-    Polyline& operator=(const Polyline&) = default;
-    Polyline& operator=(Polyline&&) = default;
+        double  scale{};
+        if (IsTranslation())
+        {
+            candidates.push_back(translate);
+        }
+        else if (Near(b, 0.0) && Near(c, 0.0))
+        {
+            const std::string   scaling = Near(a, d) ? Function("scale", {a}) : Function("scale", {a, d});
+            candidates.push_back(translated ? translate + ' ' + scaling : scaling);
+        }
+        else if (IsSimilarity(scale) && Determinant() > 0.0)
+        {
+            const std::string   rotate = Function("rotate", {Rotation()});
+            const std::string   scaling = Near(scale, 1.0) ? std::string() : ' ' + Function("scale", {scale});
+            candidates.push_back(translated ? translate + ' ' + rotate + scaling : rotate + scaling);
+            if (translated && Near(scale, 1.0))
+            {
+                // rotation about the fixed point of the transform
+                const double    det = (1.0 - a) * (1.0 - a) + b * b;
+                candidates.push_back(Function("rotate", {Rotation(), ((1.0 - a) * e - b * f) / det, (b * e + (1.0 - a) * f) / det}));
+            }
+        }
 
-    Polyline() : PolyBase("polyline") {}
-    Polyline(const std::vector<Point> &points)
-        : PolyBase("polyline", points)
-    {}
-    virtual ~Polyline() override {}
+        return {"transform", *std::min_element(candidates.begin(), candidates.end(), [](const std::string &x, const std::string &y){return x.size() < y.size();}), false};
+    }
 };
 
-class Polygon : public PolyBase
+//-----------------------------------------------------------------------------
+struct Footprint
 {
-    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/polygon
-public:
-    Polygon(const Polygon&) = default;
-    Polygon(Polygon&&) = default;
-    Polygon& operator=(const Polygon&) = default;
-    Polygon& operator=(Polygon&&) = default;
+    // Bytes held by elements, from the sizes and capacities of their
+    // containers, @see Base::Measure(). Allocator overhead is not included.
+    size_t  elements{0};
+    size_t  objects{0};         ///< the element objects, strings in the small string buffer included.
+    size_t  attributes{0};      ///< attribute vectors.
+    size_t  strings{0};         ///< heap buffers of tags, attributes and text.
+    size_t  coordinates{0};     ///< point, position and argument arrays.
+    size_t  commands{0};        ///< path commands and their step index.
+    size_t  data{0};            ///< image data owned by elements.
+    size_t  control_blocks{0};  ///< shared_ptr reference counts of children.
+    size_t  children{0};        ///< child pointer vectors.
+
+    size_t  Total() const {return objects + attributes + strings + coordinates + commands + data + control_blocks + children;}
+
+    Footprint&  operator+=(const Footprint &other)
+    {
+        elements += other.elements;
+        objects += other.objects;
+        attributes += other.attributes;
+        strings += other.strings;
+        coordinates += other.coordinates;
+        commands += other.commands;
+        data += other.data;
+        control_blocks += other.control_blocks;
+        children += other.children;
+        return *this;
+    }
 
-    Polygon() : PolyBase("polygon") {}
-    Polygon(const std::vector<Point> &points)
-        : PolyBase("polygon", points)
-    {}
-    virtual ~Polygon() override {}
+    friend std::ostream& operator<<(std::ostream &stream, const Footprint &footprint)
+    {
+        return stream << footprint.elements << " elements, " << footprint.Total() << " bytes: "
+                      << footprint.objects << " objects, " << footprint.attributes << " attributes, "
+                      << footprint.strings << " strings, " << footprint.coordinates << " coordinates, "
+                      << footprint.commands << " commands, " << footprint.data << " data, "
+                      << footprint.control_blocks << " control blocks, " << footprint.children << " children";
+    }
 };
 
-class Path : public Base
+//-----------------------------------------------------------------------------
+class Base
 {
-    // https://developer.mozilla.org/en-US/docs/Web/SVG/Tutorial/Paths
+    std::string             tag;
+    std::vector<Attribute>  attributes;
+
+protected:
+    virtual std::string Extras() const {return {};}
+    virtual void        WriteExtras(Sink &sink) const {sink << Extras();}
 
-    std::vector<std::string>    parts;
-    virtual std::string Extras() const override
+    virtual bool        SetGeometry(const Attribute &/*attribute*/)
+    /// Keeps an attribute given to AddAttribute() other than in the list of
+    /// attributes, e.g. as a number. Returns false for the ones to be listed.
     {
-        std::ostringstream  stream;
-        stream << "d=\"";
+        return false;
+    }
 
-        bool    initial{true};
-        for (const auto &p : parts)
+    bool    GeometryAttributes(std::initializer_list<const char*> names, double *values) const
+    /// Reads the named attributes, 0 if missing. Returns false if one is not a
+    /// plain number, e.g. a percentage.
+    {
+        for (const char *name : names)
         {
-            if (!initial)
-            {
-                stream << " " << p;
-            }
-            else
+            const auto  *attribute = FindAttribute(name);
+            *values = 0.0;
+            if (attribute != nullptr)
             {
-                stream << p;
-                initial = false;
+                const std::string   &text = attribute->Value();
+                if (parse_number(text.data(), text.data() + text.size(), *values) != text.data() + text.size())
+                {
+                    return false;
+                }
             }
+            ++values;
         }
+        return true;
+    }
 
-        stream << '\"';
-
-        return stream.str();
+    void    WriteAttributes(Sink &sink) const
+    {
+        for (const auto &attribute : attributes)
+        {
+            sink << ' ';
+            attribute.Serialize(sink);
+        }
     }
 
 public:
-    Path(const Path&) = default;
-    Path(Path&&) = default;
-    Path& operator=(const Path&) = default;
-    Path& operator=(Path&&) = default;
+    Base() = default;
+    Base(const Base&) = default;
+    Base(Base&&) = default;
+    Base& operator=(const Base&) = default;
+    Base& operator=(Base&&) = default;
 
-    Path() : Base("path") {}
-    virtual ~Path() override {}
+    Base(const std::string &tag) : tag(tag) {}
+    Base(const std::string &tag, const std::vector<Attribute> &attributes)
+        : tag(tag),
+          attributes(attributes)
+    {}
 
-    Path&   MoveTo(const Point &p, bool relative = true)
+    virtual ~Base() {}
+
+    std::string     Tag() const {return tag;}
+    const auto&     Attributes() const {return attributes;}
+
+    Base&   AddAttribute(const Attribute &attribute)
     {
-        std::ostringstream  stream;
-        stream << (relative ? "M" : "m")
-               << " " << p.X()
-               << " " << p.Y()
-                  ;
-        parts.push_back(stream.str());
+        if (SetGeometry(attribute))
+        {
+            return *this;
+        }
+        auto ii = std::find_if(attributes.begin(), attributes.end(), [&attribute](const auto &a){return a.Name().compare(attribute.Name())==0;});
+        if (ii != attributes.end())
+        {
+            *ii = attribute;
+        }
+        else
+        {
+            attributes.push_back(attribute);
+        }
         return *this;
     }
 
-    Path&   LineTo(const Point &p, bool relative = true)
+    Base&   ClearAttributes()
+    /// Removes all attributes, keeping the allocated storage.
     {
-        std::ostringstream  stream;
-        stream << (relative ? "L" : "l")
-               << " " << p.X()
-               << " " << p.Y()
-                  ;
-        parts.push_back(stream.str());
+        attributes.clear();
         return *this;
     }
 
-    Path&   HorizontalLineTo(double x, bool relative = true)
+    Base&   Id(const std::string &id)
     {
-        std::ostringstream  stream;
-        stream << (relative ? "H" : "h")
-               << " " << x
-                  ;
-        parts.push_back(stream.str());
-        return *this;
+        return AddAttribute({"id", id});
     }
 
-    Path&   VerticalLineTo(double y, bool relative = true)
+    Base&   Class(const std::string &class_name)
     {
-        std::ostringstream  stream;
-        stream << (relative ? "V" : "v")
-               << " " << y
-                  ;
-        parts.push_back(stream.str());
-        return *this;
+        return AddAttribute({"class", class_name});
     }
 
-    Path&   Close()
+    Base&   Stroke(const std::string &stroke)
+    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/stroke
     {
-        parts.push_back("Z");
-        return *this;
+        return AddAttribute({"stroke", stroke});
     }
 
-    Path&   Cubic(const Point &p_c1, const Point &p_c2, const Point &p_end, bool relative = true)
+    Base&   StrokeWidth(const double &stroke_width)
+    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/stroke-width
     {
-        std::ostringstream  stream;
-        stream << (relative ? "C" : "c")
-               << " " << p_c1.X()
-               << " " << p_c1.Y()
-               << "," << p_c2.X()
-               << " " << p_c2.Y()
-               << "," << p_end.X()
-               << " " << p_end.Y()
-                  ;
-        parts.push_back(stream.str());
-        return *this;
+        return AddAttribute({"stroke-width", stroke_width});
     }
 
-    Path&   Stitch(const Point &p_c2, const Point &p_end, bool relative = true)
+    Base&   StrokeOpacity(const double &stroke_opacity)
+    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/stroke-opacity
     {
-        std::ostringstream  stream;
-        stream << (relative ? "S" : "s")
-               << " " << p_c2.X()
-               << " " << p_c2.Y()
-               << "," << p_end.X()
-               << " " << p_end.Y()
-                  ;
-        parts.push_back(stream.str());
-        return *this;
+        return AddAttribute({"stroke-opacity", stroke_opacity});
     }
 
-    Path&   Quadratic(const Point &p_c, const Point &p_end, bool relative = true)
+    Base&   Fill(const std::string &fill)
+    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/fill
     {
-        std::ostringstream  stream;
-        stream << (relative ? "Q" : "q")
-               << " " << p_c.X()
-               << " " << p_c.Y()
-               << "," << p_end.X()
-               << " " << p_end.Y()
-                  ;
-        parts.push_back(stream.str());
-        return *this;
+        return AddAttribute({"fill", fill});
     }
 
-    Path&   Stitch(const Point &p_end, bool relative = true)
+    Base&   FillOpacity(const double &fill_opacity)
+    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/fill-opacity
     {
-        std::ostringstream  stream;
-        stream << (relative ? "T" : "t")
-               << " " << p_end.X()
-               << " " << p_end.Y()
-                  ;
-        parts.push_back(stream.str());
-        return *this;
+        return AddAttribute({"fill-opacity", fill_opacity});
     }
 
-    Path&   Arch(double radius_x,
-                 double radius_y,
-                 double x_axis_rotation,
-                 bool large_arc_flag,
-                 bool sweep_flag,
-                 const Point &p_end,
-                 bool relative = true)
+    Base&   Opacity(const double &opacity)
+    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/opacity
     {
-        std::ostringstream  stream;
-        stream << (relative ? "A" : "a")
-               << " " << radius_x
-               << " " << radius_y
-               << " " << x_axis_rotation
-               << " " << (large_arc_flag ? "1" : "0")
-               << " " << (sweep_flag ? "1" : "0")
-               << " " << p_end.X()
-               << " " << p_end.Y()
-                  ;
-        parts.push_back(stream.str());
-        return *this;
+        return AddAttribute({"opacity", opacity});
     }
-};
-
-class Line : public Base
-{
-    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/line
-public:
-    Line(const Line&) = default;
-    Line(Line&&) = default;
-    Line& operator=(const Line&) = default;
-    Line& operator=(Line&&) = default;
-
-    Line() : Base("line") {}
-    Line(double from_x, double from_y, double to_x, double to_y)
-        : Base("line", {{"x1",from_x},{"y1",from_y},{"x2",to_x},{"y2",to_y}})
-    {}
-    Line(const Point &from, const Point &to)
-        : Base("line", {{"x1",from.X()},{"y1",from.Y()},{"x2",to.X()},{"y2",to.Y()}})
-    {}
-    virtual ~Line() override {}
-};
 
-class Circle : public Base
-{
-    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/circle
-public:
-    Circle(const Circle&) = default;
-    Circle(Circle&&) = default;
-    Circle& operator=(const Circle&) = default;
-    Circle& operator=(Circle&&) = default;
+    const Attribute*    FindAttribute(const std::string &name) const
+    /// Returns the attribute called name or nullptr.
+    {
+        auto ii = std::find_if(attributes.begin(), attributes.end(), [&name](const auto &a){return a.Name().compare(name)==0;});
+        return ii != attributes.end() ? &*ii : nullptr;
+    }
 
-    Circle() : Base("circle") {}
-    Circle(double center_x, double center_y, double radius)
-        : Base("circle", {{"cx",center_x},{"cy",center_y},{"r",radius}})
-    {}
-    Circle(const Point &center, double radius)
-        : Base("circle", {{"cx",center.X()},{"cy",center.Y()},{"r",radius}})
-    {}
-    virtual ~Circle() override {}
-};
+    Base&   RemoveAttribute(const std::string &name)
+    {
+        attributes.erase(std::remove_if(attributes.begin(), attributes.end(), [&name](const auto &a){return a.Name().compare(name)==0;}), attributes.end());
+        return *this;
+    }
 
-class Ellipse : public Base
-{
-    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/ellipse
-public:
-    Ellipse(const Ellipse&) = default;
-    Ellipse(Ellipse&&) = default;
-    Ellipse& operator=(const Ellipse&) = default;
-    Ellipse& operator=(Ellipse&&) = default;
+    double  NumericAttribute(const std::string &name, double fallback = 0.0) const
+    {
+        const auto  *attribute = FindAttribute(name);
+        return attribute != nullptr ? to_number(attribute->Value(), fallback) : fallback;
+    }
 
-    Ellipse() : Base("ellipse") {}
-    Ellipse(double center_x, double center_y, double radius_x, double radius_y)
-        : Base("ellipse", {{"cx",center_x},{"cy",center_y},{"rx",radius_x},{"ry",radius_y}})
-    {}
-    Ellipse(const Point &center, double radius_x, double radius_y)
-        : Base("ellipse", {{"cx",center.X()},{"cy",center.Y()},{"rx",radius_x},{"ry",radius_y}})
-    {}
-    virtual ~Ellipse() override {}
-};
+    Base&   Transform(const Transform &transform)
+    {
+        if (transform.IsIdentity())
+        {
+            return RemoveAttribute("transform");
+        }
+        return AddAttribute(transform.AsAttribute());
+    }
 
-class Use : public Base
-{
-    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/use
-public:
-    Use(const Use&) = default;
-    Use(Use&&) = default;
-    Use& operator=(const Use&) = default;
-    Use& operator=(Use&&) = default;
+    simple_svg::Transform   GetTransform() const
+    /// The transform attribute parsed into a matrix, identity if there is none.
+    {
+        const auto  *attribute = FindAttribute("transform");
+        return attribute != nullptr ? simple_svg::Transform::Parse(attribute->Value()) : simple_svg::Transform();
+    }
 
-    Use() : Base("use") {}
-    Use(std::string reference_id)
-        : Base("use", {{"xlink:href", '#' + reference_id}})
-    {}
-    virtual ~Use() override {}
-};
+    virtual bool    ApplyTransform(const simple_svg::Transform &/*transform*/)
+    /// Applies transform to the geometry of the element. Returns false, and
+    /// leaves the element unchanged, when the element cannot represent the
+    /// transformed geometry, @see GroupBase::BakeTransforms().
+    {
+        return false;
+    }
 
-//-----------------------------------------------------------------------------
-class GroupBase : public Base
-{
-    std::vector<std::shared_ptr<Base>>  objects;
+    virtual bool    RemoveRedundant(bool /*capped*/)
+    /// Removes consecutive duplicate points, collinear runs and zero length
+    /// segments from the geometry of the element, keeping zero length
+    /// segments if capped, i.e. with round or square line caps drawing them
+    /// as dots. Returns false when the geometry is empty, e.g. of a zero size
+    /// Rect, and the element draws nothing, @see GroupBase::Clean().
+    {
+        return true;
+    }
 
-protected:
-    std::string StartTag() const
+    virtual Base&   StoreAs(Storage /*storage*/, int /*decimals*/ = 2)
+    /// Selects how the coordinates of the element are stored and written,
+    /// @see Coordinates. Elements with attribute geometry keep it as text.
     {
-        std::ostringstream  stream;
-        stream << "<" << Tag();
+        return *this;
+    }
 
-        for (const auto &attribute : Attributes())
+    virtual void    Measure(Footprint &footprint) const
+    /// Adds the memory held by the element, without its children.
+    {
+        ++footprint.elements;
+        footprint.objects += sizeof(Base);
+        footprint.attributes += attributes.capacity() * sizeof(Attribute);
+        footprint.strings += heap_bytes(tag);
+        for (const auto &attribute : attributes)
         {
-            stream << ' ' << attribute;
+            footprint.strings += attribute.HeapBytes();
         }
-        stream << ">";
-
-        return stream.str();
     }
 
-    std::string EndTag() const
+    virtual Base&   ShrinkToFit()
+    /// Releases unused capacity, e.g. of a long-lived document.
     {
-        std::ostringstream  stream;
-        stream << "</" << Tag() << ">";
-
-        return stream.str();
+        tag.shrink_to_fit();
+        attributes.shrink_to_fit();
+        for (auto &attribute : attributes)
+        {
+            attribute.ShrinkToFit();
+        }
+        return *this;
     }
 
-public:
-    GroupBase(const GroupBase&) = default;
-    GroupBase(GroupBase&&) = default;
-    GroupBase& operator=(const GroupBase&) = default;
-    GroupBase& operator=(GroupBase&&) = default;
+    virtual void    Serialize(Sink &sink) const
+    {
+        sink << "<" << tag;
 
-    GroupBase(std::string group_tag)
-        : Base(group_tag) {}
-    GroupBase(std::string group_tag, const std::vector<Attribute> &attributes)
-        : Base(group_tag, attributes) {}
-    virtual ~GroupBase() override {}
+        sink << ' ';
+        WriteExtras(sink);
 
-    template<typename T>
-    GroupBase&  Append(const T& object)
-    {
-        objects.push_back(std::make_shared<T>(object));
-        return *this;
+        WriteAttributes(sink);
+        sink << "/>";
     }
 
-    virtual std::string ToText() const override
+    virtual bool    SerializeStep(Sink &sink, size_t /*step*/, const Base *&/*child*/) const
+    /// Writes one bounded piece, selected by step = 0, 1, ..., of the element
+    /// and returns whether more steps follow. A child set by a step is
+    /// serialized completely before the next step, @see ChunkedWriter.
     {
-        std::ostringstream  stream;
-        stream << StartTag() << '\n';
+        Serialize(sink);
+        return false;
+    }
 
-        for (const auto &object : objects)
-        {
-            stream << "  " << *object << '\n';
-        }
+    class StepState
+    {
+        // What an element keeps from one step of a serialization to the
+        // next, e.g. an open file, @see StatefulStep().
+    public:
+        virtual ~StepState() {}
+    };
+
+    virtual bool    StatefulStep(Sink &sink, size_t step, const Base *&child, std::unique_ptr<StepState> &/*state*/) const
+    /// SerializeStep() with state kept by the caller for the steps of one
+    /// serialization, empty at step 0.
+    {
+        return SerializeStep(sink, step, child);
+    }
 
-        stream << EndTag();
+    virtual std::string ToText() const
+    /// The text Serialize() writes. Sinks and streams take Serialize()
+    /// directly, so subclasses changing the output override Serialize().
+    {
+        std::string text;
+        StringSink  sink(text);
+        Serialize(sink);
+        return text;
+    }
 
-        return stream.str();
+    size_t  TextSize() const
+    /// Returns the exact number of bytes Serialize() and ToText() produce,
+    /// without producing them, e.g. to allocate a single output buffer.
+    {
+        CountingSink    sink;
+        Serialize(sink);
+        return sink.Count();
     }
 
-    friend std::ostream& operator<<(std::ostream &stream, const GroupBase &group_base)
+    friend std::ostream& operator<<(std::ostream &stream, const Base &base)
     {
-        return stream << group_base.ToText();
+        StreamSink  sink(stream);
+        base.Serialize(sink);
+        return stream;
     }
 };
 
-class Text : public GroupBase
-{
-    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/text
 
-    std::string text;
+class Rect : public Base
+{
+    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/rect
 public:
-    Text(const Text&) = default;
-    Text(Text&&) = default;
-    Text& operator=(const Text&) = default;
-    Text& operator=(Text&&) = default;
+    Rect(const Rect&) = default;
+    Rect(Rect&&) = default;
+    Rect& operator=(const Rect&) = default;
+    Rect& operator=(Rect&&) = default;
 
-    Text(double x, double y, const std::string &text)
-        : GroupBase("text", {{"x",x},{"y",y}}),
-          text(text)
+    Rect() : Base("rect") {}
+    Rect(double x, double y, double w, double h)
+        : Base("rect", {{"x", x}, {"y", y}, {"width", w}, {"height", h}})
     {}
-    Text(const Point &where, const std::string &text)
-        : GroupBase("text", {{"x",where.X()},{"y",where.Y()}}),
-          text(text)
+    Rect(double w, double h)
+        : Base("rect", {{"width", w}, {"height", h}})
     {}
-    virtual ~Text() override {}
+    Rect(const Point &from, const Point &to)
+        : Base("rect", {{"x", from.X()}, {"y", from.Y()}, {"width", to.X() - from.X()}, {"height", to.Y() - from.Y()}})
+    {}
+    virtual ~Rect() {}
 
-    Text&   TextAnchor(const std::string &text_anchor)
-    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/text-anchor
+    virtual bool    ApplyTransform(const simple_svg::Transform &transform) override
     {
-        AddAttribute({"text-anchor", text_anchor});
-        return *this;
-    }
+        double  v[6];
+        if (!transform.IsAxisAligned() || !GeometryAttributes({"x", "y", "width", "height", "rx", "ry"}, v))
+        {
+            return false;
+        }
 
-    Text&   Right() {return TextAnchor("start");}
-    Text&   Center() {return TextAnchor("middle");}
-    Text&   Left() {return TextAnchor("end");}
+        const Point from = transform.Apply({v[0], v[1]});
+        const Point to = transform.Apply({v[0] + v[2], v[1] + v[3]});
+        AddAttribute({"x", std::min(from.X(), to.X())});
+        AddAttribute({"y", std::min(from.Y(), to.Y())});
+        AddAttribute({"width", std::fabs(to.X() - from.X())});
+        AddAttribute({"height", std::fabs(to.Y() - from.Y())});
 
-    Text&   DominantBaseline(const std::string &dominant_baseline)
-    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/dominant-baseline
+        if (FindAttribute("rx") != nullptr || FindAttribute("ry") != nullptr)
+        {
+            const double    rx = FindAttribute("rx") != nullptr ? v[4] : v[5];
+            const double    ry = FindAttribute("ry") != nullptr ? v[5] : v[4];
+            const Point     radius = transform.ApplyLinear({rx, ry});
+            AddAttribute({"rx", std::fabs(radius.X())});
+            AddAttribute({"ry", std::fabs(radius.Y())});
+        }
+        return true;
+    }
+
+    virtual bool    RemoveRedundant(bool /*capped*/) override
     {
-        AddAttribute({"dominant-baseline", dominant_baseline});
-        return *this;
+        double  v[2];
+        return !GeometryAttributes({"width", "height"}, v) || (v[0] > 0.0 && v[1] > 0.0);
     }
+};
 
-    Text&   Auto() {return DominantBaseline("auto");}       ///< standard "on line" vertical alignment.
-    Text&   Middle() {return DominantBaseline("middle");}   ///< "centered" vertical alignment.
-    Text&   Hanging() {return DominantBaseline("hanging");} ///< "hangning" vertical alignment.
+class PolyBase : public Base
+{
+    static constexpr size_t points_per_step{1024};
 
-    Text&   FontFamily(const std::string &font_family)
-    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/font-family
+    Coordinates points;     ///< x and y of every point, interleaved.
+
+    void    WritePoints(Sink &sink, size_t first, size_t last) const
     {
-        AddAttribute({"font-family", font_family});
-        return *this;
+        for (size_t i = first; i < last; ++i)
+        {
+            points.Write(sink, 2 * i);
+            sink << ',';
+            points.Write(sink, 2 * i + 1);
+            sink << ' ';
+        }
     }
 
-    Text&   FontSize(const std::string &font_size)
-    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/font-size
+protected:
+    virtual void    WriteExtras(Sink &sink) const override
     {
-        AddAttribute({"font-size", font_size});
-        return *this;
+        sink << "points=\"";
+        WritePoints(sink, 0, Count());
+        sink << '"';
     }
-    Text&   FontSize(const double &font_size) {return FontSize(std::to_string(font_size) + "pt");}
 
-    Text&   FontStyle(const std::string &font_style)
-    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/font-style
+public:
+    PolyBase(std::string tag) : Base(tag) {}
+    PolyBase(std::string tag, const std::vector<Point> &points)
+        : Base(tag)
     {
-        AddAttribute({"font-style", font_style});
-        return *this;
+        Add(points);
     }
+    virtual ~PolyBase() override {}
 
-    Text&   FontWeight(const std::string &font_weight)
-    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/font-weight
+    virtual bool    SerializeStep(Sink &sink, size_t step, const Base *&) const override
     {
-        AddAttribute({"font-weight", font_weight});
-        return *this;
+        const size_t    steps = (Count() + points_per_step - 1) / points_per_step;
+        if (step == 0)
+        {
+            sink << "<" << Tag() << " points=\"";
+        }
+        if (step < steps)
+        {
+            WritePoints(sink, step * points_per_step, std::min(Count(), (step + 1) * points_per_step));
+            return true;
+        }
+
+        sink << '"';
+        WriteAttributes(sink);
+        sink << "/>";
+        return false;
     }
 
-    Text&   Bold() {return FontWeight("bold");}
-    Text&   Italic() {return FontStyle("italic");}
-    Text&   Oblique() {return FontStyle("italic");}
-    Text&   Normal() {return FontStyle("normal").FontWeight("normal");}
+    size_t  Count() const {return points.Size() / 2;}
+    Point   At(size_t i) const {return {points.At(2 * i), points.At(2 * i + 1)};}
 
-    virtual std::string ToText() const override
+    std::vector<Point>  Points() const
     {
-        std::ostringstream  stream;
-        stream << StartTag();
-        stream << text;
-        stream << EndTag();
-
-        return stream.str();
+        std::vector<Point>  result;
+        result.reserve(Count());
+        for (size_t i = 0; i < Count(); ++i)
+        {
+            result.push_back(At(i));
+        }
+        return result;
     }
-};
 
-class Group : public GroupBase
-{
-    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/g
-public:
-    Group(const Group&) = default;
-    Group(Group&&) = default;
-    Group& operator=(const Group&) = default;
-    Group& operator=(Group&&) = default;
+    const Coordinates&  Values() const {return points;}
 
-    Group() : GroupBase("g") {}
-    virtual ~Group() override {}
+    PolyBase&   Assign(Coordinates values)
+    /// Replaces the points by values holding x and y of every point.
+    {
+        if (values.Size() % 2 != 0)
+        {
+            throw std::invalid_argument("simple_svg::PolyBase: odd number of coordinates");
+        }
+        points.Swap(values);
+        return *this;
+    }
 
-    friend std::ostream& operator<<(std::ostream &stream, const Group &group)
+    virtual bool    ApplyTransform(const simple_svg::Transform &transform) override
     {
-        return stream << group.ToText();
+        for (size_t i = 0; i < Count(); ++i)
+        {
+            const Point p = transform.Apply(At(i));
+            points.Set(2 * i, p.X());
+            points.Set(2 * i + 1, p.Y());
+        }
+        return true;
     }
-};
 
-class Layer : public GroupBase
-{
-    // Implemented as Inkscape layer based on a group, <g>, with special attributes.
-public:
-    Layer(const Layer&) = default;
-    Layer(Layer&&) = default;
-    Layer& operator=(const Layer&) = default;
-    Layer& operator=(Layer&&) = default;
+    virtual bool    RemoveRedundant(bool capped) override
+    {
+        const size_t    count = Count();
+        size_t          kept{0};
+        auto            set = [this](size_t i, const Point &p){points.Set(2 * i, p.X()); points.Set(2 * i + 1, p.Y());};
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Point p = At(i);
+            if (kept > 0 && p == At(kept - 1))
+            {
+                continue;
+            }
+            if (kept > 1 && At(kept - 1).Between(At(kept - 2), p))
+            {
+                --kept;
+            }
+            set(kept++, p);
+        }
 
-    Layer()
-        : GroupBase("g", {{"inkscape:groupmode", std::string("layer")}})
-    {}
-    Layer(const std::string &name)
-        : GroupBase("g", {{"inkscape:label", name}, {"inkscape:groupmode", std::string("layer")}})
-    {}
-    virtual ~Layer() override {}
+        if (Tag() == "polygon")
+        {
+            // the closing segment back to the first point.
+            while (kept > 1 && At(kept - 1) == At(0))
+            {
+                --kept;
+            }
+            if (kept > 2 && At(kept - 1).Between(At(kept - 2), At(0)))
+            {
+                --kept;
+            }
+            if (kept > 2 && At(0).Between(At(kept - 1), At(1)))
+            {
+                for (size_t i = 1; i < kept; ++i)
+                {
+                    set(i - 1, At(i));
+                }
+                --kept;
+            }
+        }
+
+        if (kept == 1 && count > 1 && capped)
+        {
+            // a dot.
+            set(kept++, At(0));
+        }
+        points.Truncate(2 * kept);
+        return kept > 1;
+    }
 
-    friend std::ostream& operator<<(std::ostream &stream, const Layer &group)
+    virtual PolyBase&   StoreAs(Storage storage, int decimals = 2) override
     {
-        return stream << group.ToText();
+        points.Store(storage, decimals);
+        return *this;
+    }
+
+    virtual void    Measure(Footprint &footprint) const override
+    {
+        Base::Measure(footprint);
+        footprint.objects += sizeof(PolyBase) - sizeof(Base);
+        footprint.coordinates += points.Bytes();
+    }
+
+    virtual PolyBase&   ShrinkToFit() override
+    {
+        Base::ShrinkToFit();
+        points.ShrinkToFit();
+        return *this;
+    }
+
+    PolyBase&   Add(const Point &point)
+    {
+        points.Add(point.X());
+        points.Add(point.Y());
+        return *this;
+    }
+
+    PolyBase&   Add(double x, double y)
+    {
+        return Add({x, y});
+    }
+
+    PolyBase&   Add(const std::vector<Point> &points)
+    {
+        this->points.Reserve(this->points.Size() + 2 * points.size());
+        for (const auto &p : points)
+        {
+            Add(p);
+        }
+
+        return *this;
     }
 };
 
-class Document : public GroupBase
+class Polyline : public PolyBase
 {
+    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/polyline
 public:
-    Document(const Document&) = default;
-    Document(Document&&) = default;
-    Document& operator=(const Document&) = default;
-    Document& operator=(Document&&) = default;
+    Polyline(const Polyline&) = default;
+    Polyline(Polyline&&) = default;
+    Polyline& operator=(const Polyline&) = default;
+    Polyline& operator=(Polyline&&) = default;
 
-    //<?xml version="1.0"?>
-    //<svg width="100" height="100" xmlns="http://www.w3.org/2000/svg">
-    //</svg>
-    Document()
-        : GroupBase(
-              "svg",
-    {{"xmlns", std::string("http://www.w3.org/2000/svg")},
-    {"xmlns:xlink", std::string("http://www.w3.org/1999/xlink")},
-    {"xmlns:inkscape",std::string("http://www.inkscape.org/namespaces/inkscape")}})
+    Polyline() : PolyBase("polyline") {}
+    Polyline(const std::vector<Point> &points)
+        : PolyBase("polyline", points)
     {}
-    Document(double width, double height)
-        : GroupBase(
-              "svg",
-    {{"width",to_string(width)},
-    {"height",to_string(height)},
-    {"xmlns", std::string("http://www.w3.org/2000/svg")},
-    {"xmlns:xlink", std::string("http://www.w3.org/1999/xlink")},
-    {"xmlns:inkscape",std::string("http://www.inkscape.org/namespaces/inkscape")}})
+    virtual ~Polyline() override {}
+};
+
+class Polygon : public PolyBase
+{
+    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/polygon
+public:
+    Polygon(const Polygon&) = default;
+    Polygon(Polygon&&) = default;
+    Polygon& operator=(const Polygon&) = default;
+    Polygon& operator=(Polygon&&) = default;
+
+    Polygon() : PolyBase("polygon") {}
+    Polygon(const std::vector<Point> &points)
+        : PolyBase("polygon", points)
     {}
-    virtual ~Document() override {}
+    virtual ~Polygon() override {}
+};
 
-    Document&   ViewBox(double x_min, double y_min, double width, double height)
+class Path : public Base
+{
+    // https://developer.mozilla.org/en-US/docs/Web/SVG/Tutorial/Paths
+    // Commands are kept as letters with their arguments in a single array.
+
+    static constexpr size_t commands_per_step{1024};
+
+    std::vector<char>   commands;
+    Coordinates         arguments;
+    std::vector<size_t> step_offsets;   ///< offset into arguments of every commands_per_step'th command.
+
+    void    Index()
     {
-        std::ostringstream  stream;
-        stream << x_min << ' ' << y_min << ' ' << width << ' ' << height;
-        AddAttribute({"viewBox", stream.str()});
+        step_offsets.clear();
+        size_t  offset{0};
+        for (size_t i = 0; i < commands.size(); ++i)
+        {
+            if (i % commands_per_step == 0)
+            {
+                step_offsets.push_back(offset);
+            }
+            offset += ArgumentCount(commands[i]);
+        }
+    }
+
+    void    WriteCommands(Sink &sink, size_t first, size_t last, size_t offset) const
+    {
+        for (size_t i = first; i < last; ++i)
+        {
+            const char      command = commands[i];
+            const size_t    count = ArgumentCount(command);
+            const bool      paired = std::strchr("CcSsQq", command) != nullptr;
+
+            if (i != 0)
+            {
+                sink << ' ';
+            }
+            sink << command;
+            for (size_t k = 0; k < count; ++k)
+            {
+                sink << ((paired && k != 0 && k % 2 == 0) ? ',' : ' ');
+                arguments.Write(sink, offset + k);
+            }
+            offset += count;
+        }
+    }
+
+    virtual void    WriteExtras(Sink &sink) const override
+    {
+        sink << "d=\"";
+        WriteCommands(sink, 0, commands.size(), 0);
+        sink << '"';
+    }
 
+public:
+    Path(const Path&) = default;
+    Path(Path&&) = default;
+    Path& operator=(const Path&) = default;
+    Path& operator=(Path&&) = default;
+
+    Path() : Base("path") {}
+    virtual ~Path() override {}
+
+    static size_t   ArgumentCount(char command)
+    {
+        switch (std::toupper(static_cast<unsigned char>(command)))
+        {
+        case 'M':
+        case 'L':
+        case 'T':   return 2;
+        case 'H':
+        case 'V':   return 1;
+        case 'S':
+        case 'Q':   return 4;
+        case 'C':   return 6;
+        case 'A':   return 7;
+        default:    return 0;
+        }
+    }
+
+    const std::vector<char>&    Commands() const {return commands;}
+    const Coordinates&          Arguments() const {return arguments;}
+
+    Path&   Assign(std::vector<char> commands, Coordinates arguments)
+    /// Replaces the commands and their arguments, as given by Commands() and
+    /// Arguments().
+    {
+        size_t  count{0};
+        for (const char command : commands)
+        {
+            if (std::strchr("MmLlHhVvCcSsQqTtAaZz", command) == nullptr || command == '\0')
+            {
+                throw std::invalid_argument(std::string("simple_svg::Path: unknown command ") + command);
+            }
+            count += ArgumentCount(command);
+        }
+        if (count != arguments.Size())
+        {
+            throw std::invalid_argument("simple_svg::Path: wrong number of arguments");
+        }
+        this->commands.swap(commands);
+        this->arguments.Swap(arguments);
+        Index();
         return *this;
     }
 
-    virtual std::string ToText() const override
+    Path&   Command(char command, const double *values)
+    /// Appends a command letter followed by ArgumentCount(command) values.
     {
-        std::ostringstream  stream;
-        stream << "<?xml version=\"1.0\"?>" << '\n';
+        if (std::strchr("MmLlHhVvCcSsQqTtAaZz", command) == nullptr || command == '\0')
+        {
+            throw std::invalid_argument(std::string("simple_svg::Path: unknown command ") + command);
+        }
+        const size_t    offset = arguments.Size();
+        arguments.Add(values, ArgumentCount(command));
+        if (commands.size() % commands_per_step == 0)
+        {
+            step_offsets.push_back(offset);
+        }
+        commands.push_back(command);
+        return *this;
+    }
+
+    Path&   Command(char command, std::initializer_list<double> values)
+    {
+        if (values.size() != ArgumentCount(command))
+        {
+            throw std::invalid_argument(std::string("simple_svg::Path: wrong number of arguments for ") + command);
+        }
+        return Command(command, values.begin());
+    }
+
+    virtual bool    SerializeStep(Sink &sink, size_t step, const Base *&) const override
+    {
+        const size_t    steps = step_offsets.size();
+        if (step == 0)
+        {
+            sink << "<" << Tag() << " d=\"";
+        }
+        if (step < steps)
+        {
+            WriteCommands(sink, step * commands_per_step, std::min(commands.size(), (step + 1) * commands_per_step), step_offsets[step]);
+            return true;
+        }
+
+        sink << '"';
+        WriteAttributes(sink);
+        sink << "/>";
+        return false;
+    }
+
+    virtual bool    ApplyTransform(const simple_svg::Transform &transform) override
+    {
+        double  scale{};
+        const bool  similar = transform.IsSimilarity(scale);
+        if (!similar && std::find_if(commands.begin(), commands.end(), [](char c){return c == 'A' || c == 'a';}) != commands.end())
+        {
+            return false;
+        }
+
+        const bool  straight = std::fabs(transform.B()) < 1e-12 && std::fabs(transform.C()) < 1e-12;
+        const bool  swapped = std::fabs(transform.A()) < 1e-12 && std::fabs(transform.D()) < 1e-12;
+
+        std::vector<char>   baked_commands;
+        Coordinates         baked;
+        baked.Store(arguments.Kind(), arguments.Decimals());
+        baked_commands.reserve(commands.size());
+        baked.Reserve(arguments.Size());
+
+        Point   current;
+        Point   start;
+        size_t  offset{0};
+        for (size_t i = 0; i < commands.size(); ++i)
+        {
+            // the first moveto is absolute, moved by the translation too.
+            const char      command = i == 0 && commands[i] == 'm' ? 'M' : commands[i];
+            double          v[7];
+            arguments.Copy(offset, ArgumentCount(command), v);
+            const bool      relative = std::islower(static_cast<unsigned char>(command)) != 0;
+            const char      upper = static_cast<char>(std::toupper(static_cast<unsigned char>(command)));
+            auto            apply = [&transform, relative](double x, double y){return relative ? transform.ApplyLinear({x, y}) : transform.Apply({x, y});};
+            auto            add = [&baked](const Point &p){baked.Add(p.X()); baked.Add(p.Y());};
+
+            if (upper == 'H' || upper == 'V')
+            {
+                const Point target = upper == 'H' ? Point(relative ? current.X() + v[0] : v[0], current.Y())
+                                                  : Point(current.X(), relative ? current.Y() + v[0] : v[0]);
+                const Point delta = target - current;
+                const Point moved = relative ? transform.ApplyLinear(delta) : transform.Apply(target);
+                if (straight || swapped)
+                {
+                    // stays a horizontal or vertical line, possibly turned by 90 degrees.
+                    const bool  horizontal = (upper == 'H') != swapped;
+                    baked_commands.push_back(relative ? (horizontal ? 'h' : 'v') : (horizontal ? 'H' : 'V'));
+                    baked.Add(horizontal ? moved.X() : moved.Y());
+                }
+                else
+                {
+                    baked_commands.push_back(relative ? 'l' : 'L');
+                    add(moved);
+                }
+                current = target;
+            }
+            else if (upper == 'A')
+            {
+                const bool  reflected = transform.Determinant() < 0.0;
+                baked_commands.push_back(command);
+                baked.Add(v[0] * scale);
+                baked.Add(v[1] * scale);
+                baked.Add(reflected ? transform.Rotation() - v[2] : transform.Rotation() + v[2]);
+                baked.Add(v[3]);
+                baked.Add(reflected ? 1.0 - v[4] : v[4]);
+                add(apply(v[5], v[6]));
+                current = relative ? current + Point(v[5], v[6]) : Point(v[5], v[6]);
+            }
+            else if (upper == 'Z')
+            {
+                baked_commands.push_back(command);
+                current = start;
+            }
+            else
+            {
+                const size_t    count = ArgumentCount(command);
+                baked_commands.push_back(command);
+                for (size_t k = 0; k < count; k += 2)
+                {
+                    add(apply(v[k], v[k + 1]));
+                }
+                current = relative ? current + Point(v[count - 2], v[count - 1]) : Point(v[count - 2], v[count - 1]);
+                if (upper == 'M')
+                {
+                    start = current;
+                }
+            }
+            offset += ArgumentCount(command);
+        }
+
+        commands.swap(baked_commands);
+        arguments.Swap(baked);
+        Index();
+        return true;
+    }
+
+    virtual bool    RemoveRedundant(bool capped) override
+    {
+        // absolute positions are tracked along, so that relative commands
+        // after a removed or merged one keep their arguments.
+        std::vector<char>   cleaned_commands;
+        std::vector<double> cleaned;
+        cleaned_commands.reserve(commands.size());
+        cleaned.reserve(arguments.Size());
+
+        Point   current;
+        Point   start;
+        Point   from;               ///< where the last cleaned command starts.
+        size_t  from_offset{0};     ///< of its arguments.
+        size_t  offset{0};
+        auto    line = [](char command){return command != '\0' && std::strchr("LlHhVv", command) != nullptr;};
+        for (size_t i = 0; i < commands.size(); ++i)
+        {
+            const char      command = commands[i];
+            const size_t    count = ArgumentCount(command);
+            double          v[7];
+            arguments.Copy(offset, count, v);
+            offset += count;
+
+            const bool  relative = std::islower(static_cast<unsigned char>(command)) != 0;
+            const char  upper = static_cast<char>(std::toupper(static_cast<unsigned char>(command)));
+            const Point origin = relative ? current : Point();
+            Point       next = upper == 'Z' ? start : current;
+            if (upper == 'H')
+            {
+                next = Point(origin.X() + v[0], current.Y());
+            }
+            else if (upper == 'V')
+            {
+                next = Point(current.X(), origin.Y() + v[0]);
+            }
+            else if (count >= 2)
+            {
+                next = origin + Point(v[count - 2], v[count - 1]);
+            }
+
+            const char  last = cleaned_commands.empty() ? '\0' : cleaned_commands.back();
+            // S and T reflect the control point of a curve right before them.
+            const bool  smooth_next = i + 1 < commands.size() && std::strchr("SsTt", commands[i + 1]) != nullptr;
+            if (upper == 'M' && (last == 'M' || last == 'm'))
+            {
+                // an empty subpath.
+                cleaned.resize(from_offset);
+                cleaned_commands.back() = 'M';
+                cleaned.push_back(next.X());
+                cleaned.push_back(next.Y());
+                current = start = next;
+                continue;
+            }
+            if ((line(command) || upper == 'A') && next == current && !capped && !smooth_next)
+            {
+                continue;
+            }
+            if (line(command) && line(last) && current.Between(from, next))
+            {
+                // one line from the start of the last one.
+                const bool  last_relative = std::islower(static_cast<unsigned char>(last)) != 0;
+                const char  last_upper = static_cast<char>(std::toupper(static_cast<unsigned char>(last)));
+                const Point delta = next - from;
+                cleaned.resize(from_offset);
+                if (last_upper == 'H' && next.Y() == from.Y())
+                {
+                    cleaned.push_back(last_relative ? delta.X() : next.X());
+                }
+                else if (last_upper == 'V' && next.X() == from.X())
+                {
+                    cleaned.push_back(last_relative ? delta.Y() : next.Y());
+                }
+                else
+                {
+                    cleaned_commands.back() = last_relative ? 'l' : 'L';
+                    cleaned.push_back(last_relative ? delta.X() : next.X());
+                    cleaned.push_back(last_relative ? delta.Y() : next.Y());
+                }
+                current = next;
+                continue;
+            }
+            if (upper == 'Z' && line(last) && current == start)
+            {
+                // the closing line draws the same.
+                cleaned.resize(from_offset);
+                cleaned_commands.pop_back();
+            }
+
+            from = current;
+            from_offset = cleaned.size();
+            cleaned_commands.push_back(command);
+            cleaned.insert(cleaned.end(), v, v + count);
+            current = next;
+            if (upper == 'M')
+            {
+                start = next;
+            }
+        }
+
+        if (!cleaned_commands.empty() && (cleaned_commands.back() == 'M' || cleaned_commands.back() == 'm'))
+        {
+            cleaned.resize(from_offset);
+            cleaned_commands.pop_back();
+        }
+
+        Coordinates values;
+        values.Store(arguments.Kind(), arguments.Decimals());
+        values.Add(cleaned.data(), cleaned.size());
+        commands.swap(cleaned_commands);
+        arguments.Swap(values);
+        Index();
+        return !commands.empty();
+    }
+
+    virtual Path&   StoreAs(Storage storage, int decimals = 2) override
+    {
+        arguments.Store(storage, decimals);
+        return *this;
+    }
+
+    virtual void    Measure(Footprint &footprint) const override
+    {
+        Base::Measure(footprint);
+        footprint.objects += sizeof(Path) - sizeof(Base);
+        footprint.commands += commands.capacity() + step_offsets.capacity() * sizeof(size_t);
+        footprint.coordinates += arguments.Bytes();
+    }
 
-        stream << GroupBase::ToText();
+    virtual Path&   ShrinkToFit() override
+    {
+        Base::ShrinkToFit();
+        commands.shrink_to_fit();
+        step_offsets.shrink_to_fit();
+        arguments.ShrinkToFit();
+        return *this;
+    }
+
+    Path&   MoveTo(const Point &p, bool relative = true)
+    {
+        return Command(relative ? 'M' : 'm', {p.X(), p.Y()});
+    }
+
+    Path&   LineTo(const Point &p, bool relative = true)
+    {
+        return Command(relative ? 'L' : 'l', {p.X(), p.Y()});
+    }
+
+    Path&   HorizontalLineTo(double x, bool relative = true)
+    {
+        return Command(relative ? 'H' : 'h', {x});
+    }
+
+    Path&   VerticalLineTo(double y, bool relative = true)
+    {
+        return Command(relative ? 'V' : 'v', {y});
+    }
+
+    Path&   Close()
+    {
+        return Command('Z', {});
+    }
+
+    Path&   Cubic(const Point &p_c1, const Point &p_c2, const Point &p_end, bool relative = true)
+    {
+        return Command(relative ? 'C' : 'c', {p_c1.X(), p_c1.Y(), p_c2.X(), p_c2.Y(), p_end.X(), p_end.Y()});
+    }
 
-        return stream.str();
+    Path&   Stitch(const Point &p_c2, const Point &p_end, bool relative = true)
+    {
+        return Command(relative ? 'S' : 's', {p_c2.X(), p_c2.Y(), p_end.X(), p_end.Y()});
     }
 
-    friend std::ostream& operator<<(std::ostream &stream, const Document &document)
+    Path&   Quadratic(const Point &p_c, const Point &p_end, bool relative = true)
     {
-        return stream << document.ToText();
+        return Command(relative ? 'Q' : 'q', {p_c.X(), p_c.Y(), p_end.X(), p_end.Y()});
+    }
+
+    Path&   Stitch(const Point &p_end, bool relative = true)
+    {
+        return Command(relative ? 'T' : 't', {p_end.X(), p_end.Y()});
+    }
+
+    Path&   Arch(double radius_x,
+                 double radius_y,
+                 double x_axis_rotation,
+                 bool large_arc_flag,
+                 bool sweep_flag,
+                 const Point &p_end,
+                 bool relative = true)
+    {
+        return Command(relative ? 'A' : 'a', {radius_x, radius_y, x_axis_rotation, large_arc_flag ? 1.0 : 0.0, sweep_flag ? 1.0 : 0.0, p_end.X(), p_end.Y()});
+    }
+};
+
+class Line : public Base
+{
+    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/line
+public:
+    Line(const Line&) = default;
+    Line(Line&&) = default;
+    Line& operator=(const Line&) = default;
+    Line& operator=(Line&&) = default;
+
+    Line() : Base("line") {}
+    Line(double from_x, double from_y, double to_x, double to_y)
+        : Base("line", {{"x1",from_x},{"y1",from_y},{"x2",to_x},{"y2",to_y}})
+    {}
+    Line(const Point &from, const Point &to)
+        : Base("line", {{"x1",from.X()},{"y1",from.Y()},{"x2",to.X()},{"y2",to.Y()}})
+    {}
+    virtual ~Line() override {}
+
+    virtual bool    ApplyTransform(const simple_svg::Transform &transform) override
+    {
+        double  v[4];
+        if (!GeometryAttributes({"x1", "y1", "x2", "y2"}, v))
+        {
+            return false;
+        }
+
+        const Point from = transform.Apply({v[0], v[1]});
+        const Point to = transform.Apply({v[2], v[3]});
+        AddAttribute({"x1", from.X()});
+        AddAttribute({"y1", from.Y()});
+        AddAttribute({"x2", to.X()});
+        AddAttribute({"y2", to.Y()});
+        return true;
+    }
+
+    virtual bool    RemoveRedundant(bool capped) override
+    {
+        double  v[4];
+        return capped || !GeometryAttributes({"x1", "y1", "x2", "y2"}, v) || !(Point(v[0], v[1]) == Point(v[2], v[3]));
+    }
+};
+
+class Circle : public Base
+{
+    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/circle
+public:
+    Circle(const Circle&) = default;
+    Circle(Circle&&) = default;
+    Circle& operator=(const Circle&) = default;
+    Circle& operator=(Circle&&) = default;
+
+    Circle() : Base("circle") {}
+    Circle(double center_x, double center_y, double radius)
+        : Base("circle", {{"cx",center_x},{"cy",center_y},{"r",radius}})
+    {}
+    Circle(const Point &center, double radius)
+        : Base("circle", {{"cx",center.X()},{"cy",center.Y()},{"r",radius}})
+    {}
+    virtual ~Circle() override {}
+
+    virtual bool    ApplyTransform(const simple_svg::Transform &transform) override
+    {
+        double  v[3];
+        double  scale{};
+        if (!transform.IsSimilarity(scale) || !GeometryAttributes({"cx", "cy", "r"}, v))
+        {
+            return false;
+        }
+
+        const Point center = transform.Apply({v[0], v[1]});
+        AddAttribute({"cx", center.X()});
+        AddAttribute({"cy", center.Y()});
+        AddAttribute({"r", v[2] * scale});
+        return true;
+    }
+
+    virtual bool    RemoveRedundant(bool /*capped*/) override
+    {
+        double  v[1];
+        return !GeometryAttributes({"r"}, v) || v[0] > 0.0;
+    }
+};
+
+class Ellipse : public Base
+{
+    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/ellipse
+public:
+    Ellipse(const Ellipse&) = default;
+    Ellipse(Ellipse&&) = default;
+    Ellipse& operator=(const Ellipse&) = default;
+    Ellipse& operator=(Ellipse&&) = default;
+
+    Ellipse() : Base("ellipse") {}
+    Ellipse(double center_x, double center_y, double radius_x, double radius_y)
+        : Base("ellipse", {{"cx",center_x},{"cy",center_y},{"rx",radius_x},{"ry",radius_y}})
+    {}
+    Ellipse(const Point &center, double radius_x, double radius_y)
+        : Base("ellipse", {{"cx",center.X()},{"cy",center.Y()},{"rx",radius_x},{"ry",radius_y}})
+    {}
+    virtual ~Ellipse() override {}
+
+    virtual bool    ApplyTransform(const simple_svg::Transform &transform) override
+    {
+        double  v[4];
+        if (!transform.IsAxisAligned() || !GeometryAttributes({"cx", "cy", "rx", "ry"}, v))
+        {
+            return false;
+        }
+
+        const Point center = transform.Apply({v[0], v[1]});
+        const Point radius = transform.ApplyLinear({v[2], v[3]});
+        AddAttribute({"cx", center.X()});
+        AddAttribute({"cy", center.Y()});
+        AddAttribute({"rx", std::fabs(radius.X())});
+        AddAttribute({"ry", std::fabs(radius.Y())});
+        return true;
+    }
+
+    virtual bool    RemoveRedundant(bool /*capped*/) override
+    {
+        // a missing radius is the other one.
+        double  v[2];
+        if (!GeometryAttributes({"rx", "ry"}, v))
+        {
+            return true;
+        }
+        const double    rx = FindAttribute("rx") != nullptr ? v[0] : v[1];
+        const double    ry = FindAttribute("ry") != nullptr ? v[1] : v[0];
+        return rx > 0.0 && ry > 0.0;
+    }
+};
+
+//-----------------------------------------------------------------------------
+class FixedBase : public Base
+{
+    // Element whose geometry is a fixed set of numbers, written without
+    // building attributes, @see FixedElement.
+public:
+    using Base::Base;
+    virtual ~FixedBase() override {}
+
+    virtual std::shared_ptr<Base>   Expand() const = 0;
+    ///< The equivalent element of attributes, e.g. a Circle for a FixedCircle.
+};
+
+template<typename Schema, typename Derived>
+class FixedElement : public FixedBase
+{
+    // Keeps the geometry attributes named by Schema as numbers and writes
+    // them through byte fragments concatenated at compile time, so that
+    // writing an element takes a few copies and number conversions. The
+    // output equals that of Schema::Element with the same attributes.
+    // Geometry attributes given to AddAttribute(), also through a Base&, set
+    // the numbers and are rejected unless they are plain numbers.
+    static constexpr size_t count{sizeof(Schema::names) / sizeof(Schema::names[0])};
+
+    struct Fragments
+    {
+        char    text[64]{};
+        size_t  offsets[count + 2]{};   ///< of the text before every number, and after the last.
+    };
+
+    static constexpr Fragments  Build()
+    {
+        Fragments   fragments{};
+        size_t      size{0};
+        auto        append = [&fragments, &size](const char *text)
+        {
+            while (*text != '\0')
+            {
+                fragments.text[size++] = *text++;
+            }
+        };
+
+        append("<");
+        append(Schema::tag);
+        append("  ");
+        for (size_t i = 0; i < count; ++i)
+        {
+            append(i == 0 ? "" : "\" ");
+            append(Schema::names[i]);
+            append("=\"");
+            fragments.offsets[i + 1] = size;
+        }
+        append("\"");
+        fragments.offsets[count + 1] = size;
+        return fragments;
+    }
+
+    static constexpr Fragments  fragments{Build()};
+    static_assert(fragments.offsets[count + 1] < sizeof(fragments.text), "fragments too long");
+
+    static size_t   Index(const std::string &name)
+    {
+        size_t  i{0};
+        while (i < count && name != Schema::names[i])
+        {
+            ++i;
+        }
+        return i;
+    }
+
+protected:
+    double  values[count]{};
+
+    virtual bool    SetGeometry(const Attribute &attribute) override
+    {
+        const size_t    i = Index(attribute.Name());
+        if (i == count)
+        {
+            return false;
+        }
+
+        // a percentage or length with units has no number to write.
+        const std::string   &text = attribute.Value();
+        double              value{0.0};
+        if (text.empty() || parse_number(text.data(), text.data() + text.size(), value) != text.data() + text.size())
+        {
+            throw std::invalid_argument("simple_svg::FixedElement: " + attribute.Name() + " is not a number: \"" + text + "\"");
+        }
+        values[i] = value;
+        return true;
+    }
+
+    typename Schema::Element    Expanded() const
+    {
+        typename Schema::Element    element;
+        for (size_t i = 0; i < count; ++i)
+        {
+            element.AddAttribute({Schema::names[i], values[i]});
+        }
+        for (const auto &attribute : Attributes())
+        {
+            element.AddAttribute(attribute);
+        }
+        return element;
+    }
+
+public:
+    FixedElement() : FixedBase(Schema::tag) {}
+    virtual ~FixedElement() override {}
+
+    double      Geometry(size_t i) const {return values[i];}
+    Derived&    Geometry(size_t i, double value)
+    {
+        values[i] = value;
+        return static_cast<Derived&>(*this);
+    }
+
+    Derived&    AddAttribute(const Attribute &attribute) {Base::AddAttribute(attribute); return static_cast<Derived&>(*this);}
+
+    Derived&    Id(const std::string &id) {Base::Id(id); return static_cast<Derived&>(*this);}
+    Derived&    Class(const std::string &class_name) {Base::Class(class_name); return static_cast<Derived&>(*this);}
+    Derived&    Stroke(const std::string &stroke) {Base::Stroke(stroke); return static_cast<Derived&>(*this);}
+    Derived&    StrokeWidth(const double &stroke_width) {Base::StrokeWidth(stroke_width); return static_cast<Derived&>(*this);}
+    Derived&    StrokeOpacity(const double &stroke_opacity) {Base::StrokeOpacity(stroke_opacity); return static_cast<Derived&>(*this);}
+    Derived&    Fill(const std::string &fill) {Base::Fill(fill); return static_cast<Derived&>(*this);}
+    Derived&    FillOpacity(const double &fill_opacity) {Base::FillOpacity(fill_opacity); return static_cast<Derived&>(*this);}
+    Derived&    Opacity(const double &opacity) {Base::Opacity(opacity); return static_cast<Derived&>(*this);}
+    Derived&    Transform(const simple_svg::Transform &transform) {Base::Transform(transform); return static_cast<Derived&>(*this);}
+
+    virtual std::shared_ptr<Base>   Expand() const override
+    {
+        return std::make_shared<typename Schema::Element>(Expanded());
+    }
+
+    virtual bool    ApplyTransform(const simple_svg::Transform &transform) override
+    {
+        auto    element = Expanded();
+        if (!element.ApplyTransform(transform))
+        {
+            return false;
+        }
+        ClearAttributes();
+        for (const auto &attribute : element.Attributes())
+        {
+            AddAttribute(attribute);
+        }
+        return true;
+    }
+
+    virtual bool    RemoveRedundant(bool capped) override
+    {
+        return Expanded().RemoveRedundant(capped);
+    }
+
+    virtual void    Measure(Footprint &footprint) const override
+    {
+        Base::Measure(footprint);
+        footprint.objects += sizeof(Derived) - sizeof(Base);
+    }
+
+    virtual void    Serialize(Sink &sink) const override
+    {
+        // the start tag up to the other attributes in one piece.
+        char    buffer[sizeof(fragments.text) + count * 32 + 2];
+        size_t  size{0};
+        for (size_t i = 0; i <= count; ++i)
+        {
+            const size_t    length = fragments.offsets[i + 1] - fragments.offsets[i];
+            std::memcpy(buffer + size, fragments.text + fragments.offsets[i], length);
+            size += length;
+            if (i < count)
+            {
+                size += format_number(buffer + size, 32, values[i]);
+            }
+        }
+
+        if (Attributes().empty())
+        {
+            buffer[size++] = '/';
+            buffer[size++] = '>';
+            sink.Write(buffer, size);
+            return;
+        }
+        sink.Write(buffer, size);
+        WriteAttributes(sink);
+        sink << "/>";
+    }
+};
+
+struct CircleSchema
+{
+    using Element = Circle;
+    static constexpr const char *tag{"circle"};
+    static constexpr const char *names[]{"cx", "cy", "r"};
+};
+
+struct EllipseSchema
+{
+    using Element = Ellipse;
+    static constexpr const char *tag{"ellipse"};
+    static constexpr const char *names[]{"cx", "cy", "rx", "ry"};
+};
+
+struct LineSchema
+{
+    using Element = Line;
+    static constexpr const char *tag{"line"};
+    static constexpr const char *names[]{"x1", "y1", "x2", "y2"};
+};
+
+struct RectSchema
+{
+    using Element = Rect;
+    static constexpr const char *tag{"rect"};
+    static constexpr const char *names[]{"x", "y", "width", "height"};
+};
+
+class FixedCircle : public FixedElement<CircleSchema, FixedCircle>
+{
+    // Circle of numeric geometry written without attribute strings, e.g.
+    // for scatter plots of many points.
+public:
+    FixedCircle(double center_x, double center_y, double radius)
+    {
+        values[0] = center_x;
+        values[1] = center_y;
+        values[2] = radius;
+    }
+    FixedCircle(const Point &center, double radius) : FixedCircle(center.X(), center.Y(), radius) {}
+    virtual ~FixedCircle() override {}
+
+    Point   Center() const {return {values[0], values[1]};}
+    double  Radius() const {return values[2];}
+};
+
+class FixedEllipse : public FixedElement<EllipseSchema, FixedEllipse>
+{
+public:
+    FixedEllipse(double center_x, double center_y, double radius_x, double radius_y)
+    {
+        values[0] = center_x;
+        values[1] = center_y;
+        values[2] = radius_x;
+        values[3] = radius_y;
+    }
+    FixedEllipse(const Point &center, double radius_x, double radius_y) : FixedEllipse(center.X(), center.Y(), radius_x, radius_y) {}
+    virtual ~FixedEllipse() override {}
+
+    Point   Center() const {return {values[0], values[1]};}
+    Point   Radius() const {return {values[2], values[3]};}
+};
+
+class FixedLine : public FixedElement<LineSchema, FixedLine>
+{
+public:
+    FixedLine(double from_x, double from_y, double to_x, double to_y)
+    {
+        values[0] = from_x;
+        values[1] = from_y;
+        values[2] = to_x;
+        values[3] = to_y;
+    }
+    FixedLine(const Point &from, const Point &to) : FixedLine(from.X(), from.Y(), to.X(), to.Y()) {}
+    virtual ~FixedLine() override {}
+
+    Point   From() const {return {values[0], values[1]};}
+    Point   To() const {return {values[2], values[3]};}
+};
+
+class FixedRect : public FixedElement<RectSchema, FixedRect>
+{
+public:
+    FixedRect(double x, double y, double w, double h)
+    {
+        values[0] = x;
+        values[1] = y;
+        values[2] = w;
+        values[3] = h;
+    }
+    FixedRect(const Point &from, const Point &to) : FixedRect(from.X(), from.Y(), to.X() - from.X(), to.Y() - from.Y()) {}
+    virtual ~FixedRect() override {}
+
+    Point   From() const {return {values[0], values[1]};}
+    Point   Size() const {return {values[2], values[3]};}
+};
+
+class Use : public Base
+{
+    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/use
+public:
+    Use(const Use&) = default;
+    Use(Use&&) = default;
+    Use& operator=(const Use&) = default;
+    Use& operator=(Use&&) = default;
+
+    Use() : Base("use") {}
+    Use(std::string reference_id)
+        : Base("use", {{"xlink:href", '#' + reference_id}})
+    {}
+    virtual ~Use() override {}
+};
+
+class Image : public Base
+{
+    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/image
+    // Linked, or embedded as a base64 data URI encoded straight into the sink
+    // block by block while serializing, so the encoded text is never held in
+    // memory. Embedded data is read from a file when serializing, from a
+    // buffer the caller keeps alive, e.g. a memory mapped file, or from data
+    // owned by the element.
+public:
+    enum class Source
+    {
+        Link,
+        File,
+        Buffer
+    };
+
+private:
+    static constexpr size_t bytes_per_step{48 * 1024};  ///< multiple of 3, encoded to 64 KiB.
+
+    Source                                      source{Source::Link};
+    std::string                                 location;   ///< url or file path.
+    std::string                                 mime;
+    const uint8_t                               *data{nullptr};
+    size_t                                      size{0};
+    std::shared_ptr<const std::vector<uint8_t>> owned;
+
+    struct Reading : StepState
+    {
+        std::ifstream   file;       ///< of a Source::File image, positioned at the next bytes to write.
+        size_t          total{0};   ///< bytes of data.
+    };
+
+    void    Open(Reading &reading) const
+    /// Opens the data of the element for one serialization.
+    {
+        reading.total = size;
+        if (source != Source::File)
+        {
+            return;
+        }
+        reading.file.open(location, std::ios::binary | std::ios::ate);
+        if (!reading.file)
+        {
+            throw std::runtime_error("simple_svg::Image: cannot read " + location);
+        }
+        reading.total = static_cast<size_t>(reading.file.tellg());
+        reading.file.seekg(0);
+    }
+
+    void    WriteHref(Sink &sink, size_t first, size_t last, Reading &reading) const
+    /// Writes the encoded bytes [first, last) of the data, continuing where
+    /// the previous call stopped, with the start of the data URI if first is 0.
+    {
+        if (first == 0)
+        {
+            sink << "data:" << mime << ";base64,";
+        }
+        last = std::min(last, reading.total);
+        if (first >= last)
+        {
+            return;
+        }
+        if (sink.Skip(base64_size(last - first)))
+        {
+            if (source == Source::File)
+            {
+                reading.file.seekg(static_cast<std::streamoff>(last));
+            }
+            return;
+        }
+
+        std::vector<char>       text(base64_size(bytes_per_step));
+        std::vector<uint8_t>    bytes(source == Source::File ? bytes_per_step : 0);
+        std::ifstream           &file = reading.file;
+        for (size_t offset = first; offset < last; offset += bytes_per_step)
+        {
+            const size_t    count = std::min(bytes_per_step, last - offset);
+            const uint8_t   *block = data + offset;
+            if (source == Source::File)
+            {
+                if (!file.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(count)))
+                {
+                    throw std::runtime_error("simple_svg::Image: cannot read " + location);
+                }
+                block = bytes.data();
+            }
+            sink.Write(text.data(), base64_encode(block, count, text.data()));
+        }
+    }
+
+protected:
+    virtual void    WriteExtras(Sink &sink) const override
+    {
+        sink << "xlink:href=\"";
+        if (source == Source::Link)
+        {
+            sink.WriteEscaped(location);
+        }
+        else
+        {
+            Reading reading;
+            Open(reading);
+            WriteHref(sink, 0, reading.total, reading);
+        }
+        sink << '"';
+    }
+
+public:
+    Image(const Image&) = default;
+    Image(Image&&) = default;
+    Image& operator=(const Image&) = default;
+    Image& operator=(Image&&) = default;
+
+    Image() : Base("image") {}
+    Image(double x, double y, double width, double height)
+        : Base("image", {{"x", x}, {"y", y}, {"width", width}, {"height", height}})
+    {}
+    virtual ~Image() override {}
+
+    static std::string  MimeType(const std::string &path)
+    /// The media type of an image file by its extension, empty if unknown.
+    {
+        std::string extension = path.substr(path.find_last_of('.') + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c){return static_cast<char>(std::tolower(c));});
+        if (extension == "png")                         return "image/png";
+        if (extension == "jpg" || extension == "jpeg")  return "image/jpeg";
+        if (extension == "gif")                         return "image/gif";
+        if (extension == "webp")                        return "image/webp";
+        if (extension == "svg")                         return "image/svg+xml";
+        return {};
+    }
+
+    Image&  Link(const std::string &url)
+    /// Refers to the image by url instead of embedding it.
+    {
+        source = Source::Link;
+        location = url;
+        mime.clear();
+        data = nullptr;
+        size = 0;
+        owned.reset();
+        return *this;
+    }
+
+    Image&  File(const std::string &path, const std::string &mime = std::string())
+    /// Embeds the file at path, read when serializing, of the media type
+    /// given by its extension unless mime is given.
+    {
+        const std::string   type = mime.empty() ? MimeType(path) : mime;
+        if (type.empty())
+        {
+            throw std::invalid_argument("simple_svg::Image: unknown media type of " + path);
+        }
+        Link(path);
+        source = Source::File;
+        this->mime = type;
+        return *this;
+    }
+
+    Image&  Data(const uint8_t *data, size_t size, const std::string &mime)
+    /// Embeds size bytes at data, which must stay valid while the element is
+    /// serialized.
+    {
+        Link(std::string());
+        source = Source::Buffer;
+        this->mime = mime;
+        this->data = data;
+        this->size = size;
+        return *this;
+    }
+
+    Image&  Data(std::vector<uint8_t> data, const std::string &mime)
+    /// Embeds data, shared by copies of the element.
+    {
+        auto    shared = std::make_shared<const std::vector<uint8_t>>(std::move(data));
+        Data(shared->data(), shared->size(), mime);
+        owned = std::move(shared);
+        return *this;
+    }
+
+    Source              Kind() const {return source;}
+    const std::string&  Location() const {return location;}
+    const std::string&  Mime() const {return mime;}
+    const uint8_t*      Bytes() const {return data;}
+    size_t              Size() const {return size;}
+
+    virtual void    Measure(Footprint &footprint) const override
+    {
+        Base::Measure(footprint);
+        footprint.objects += sizeof(Image) - sizeof(Base);
+        footprint.strings += heap_bytes(location) + heap_bytes(mime);
+        footprint.data += owned ? owned->capacity() : 0;
+    }
+
+    virtual Image&  ShrinkToFit() override
+    {
+        Base::ShrinkToFit();
+        location.shrink_to_fit();
+        mime.shrink_to_fit();
+        return *this;
+    }
+
+    virtual bool    ApplyTransform(const simple_svg::Transform &transform) override
+    {
+        double  v[4];
+        if (!transform.IsAxisAligned() || transform.A() <= 0.0 || transform.D() <= 0.0 || !GeometryAttributes({"x", "y", "width", "height"}, v))
+        {
+            // the image would be mirrored or turned.
+            return false;
+        }
+
+        const Point from = transform.Apply({v[0], v[1]});
+        AddAttribute({"x", from.X()});
+        AddAttribute({"y", from.Y()});
+        AddAttribute({"width", v[2] * transform.A()});
+        AddAttribute({"height", v[3] * transform.D()});
+        return true;
+    }
+
+    virtual bool    StatefulStep(Sink &sink, size_t step, const Base *&child, std::unique_ptr<StepState> &state) const override
+    {
+        if (source == Source::Link)
+        {
+            return Base::SerializeStep(sink, step, child);
+        }
+
+        // the file is opened once, and read on from step to step.
+        if (!state)
+        {
+            auto    reading = std::make_unique<Reading>();
+            Open(*reading);
+            state = std::move(reading);
+        }
+        Reading &reading = static_cast<Reading&>(*state);
+        if (step == 0)
+        {
+            sink << "<" << Tag() << " xlink:href=\"";
+        }
+        WriteHref(sink, step * bytes_per_step, (step + 1) * bytes_per_step, reading);
+        if ((step + 1) * bytes_per_step < reading.total)
+        {
+            return true;
+        }
+
+        sink << '"';
+        WriteAttributes(sink);
+        sink << "/>";
+        return false;
+    }
+};
+
+//-----------------------------------------------------------------------------
+class MarkerBatch : public Base
+{
+    // Many copies of one marker shape sharing the style of the batch, kept as
+    // columns of positions and sizes instead of an element each. Written as a
+    // single <path>, or with UseMarker() as a <g> holding the marker once in
+    // <defs> and a <use> per copy.
+    //
+    // The marker is a path in unit size starting with an absolute 'M'
+    // followed by relative commands only, e.g. "M -1 0 a 1 1 0 1 0 2 0 ...".
+    static constexpr size_t markers_per_step{1024};
+
+    Path        marker;
+    double      width{1.0};         ///< size of copies added without one.
+    double      height{1.0};
+    Coordinates positions;          ///< x and y of every copy, interleaved.
+    Coordinates sizes;              ///< width and height of every copy, empty while all have the default size.
+    std::string marker_id;          ///< of the marker in <defs>, empty when written as a path.
+
+    double  Width(size_t i) const {return sizes.Size() != 0 ? sizes.At(2 * i) : width;}
+    double  Height(size_t i) const {return sizes.Size() != 0 ? sizes.At(2 * i + 1) : height;}
+
+    static double   Scale(char command, size_t k, double width, double height)
+    /// Factor for argument k of a relative command, arc rotation and flags
+    /// are not scaled.
+    {
+        switch (command)
+        {
+        case 'h':   return width;
+        case 'v':   return height;
+        case 'a':   return (k == 0 || k == 5) ? width : ((k == 1 || k == 6) ? height : 1.0);
+        default:    return k % 2 == 0 ? width : height;
+        }
+    }
+
+    template<typename Function>
+    void    ForEachCommand(double x, double y, double width, double height, Function function) const
+    /// Calls function(command, values) for the commands of the marker placed
+    /// at x, y in size width, height.
+    {
+        const auto  &arguments = marker.Arguments();
+        double      values[7]{x + width * arguments.At(0), y + height * arguments.At(1)};
+        function('M', values);
+
+        size_t  offset{2};
+        for (size_t c = 1; c < marker.Commands().size(); ++c)
+        {
+            const char      command = marker.Commands()[c];
+            const size_t    count = Path::ArgumentCount(command);
+            for (size_t k = 0; k < count; ++k)
+            {
+                values[k] = arguments.At(offset + k) * Scale(command, k, width, height);
+            }
+            function(command, values);
+            offset += count;
+        }
+    }
+
+    void    WriteMarker(Sink &sink, double x, double y, double width, double height) const
+    {
+        // formatted as Path writes its commands, numbers as the positions.
+        bool    first{true};
+        ForEachCommand(x, y, width, height, [this, &sink, &first](char command, const double *values)
+        {
+            const bool  paired = std::strchr("CcSsQq", command) != nullptr;
+            if (!first)
+            {
+                sink << ' ';
+            }
+            sink << command;
+            for (size_t k = 0; k < Path::ArgumentCount(command); ++k)
+            {
+                sink << ((paired && k != 0 && k % 2 == 0) ? ',' : ' ');
+                positions.WriteValue(sink, values[k]);
+            }
+            first = false;
+        });
+    }
+
+    void    WritePath(Sink &sink, size_t first, size_t last) const
+    {
+        for (size_t i = first; i < last; ++i)
+        {
+            if (i != 0)
+            {
+                sink << ' ';
+            }
+            WriteMarker(sink, positions.At(2 * i), positions.At(2 * i + 1), Width(i), Height(i));
+        }
+    }
+
+    void    WriteUses(Sink &sink, size_t first, size_t last) const
+    {
+        for (size_t i = first; i < last; ++i)
+        {
+            sink << "\n  <use xlink:href=\"#";
+            sink.WriteEscaped(marker_id.data(), marker_id.size());
+            if (sizes.Size() == 0)
+            {
+                sink << "\" x=\"";
+                positions.Write(sink, 2 * i);
+                sink << "\" y=\"";
+                positions.Write(sink, 2 * i + 1);
+            }
+            else
+            {
+                sink << "\" transform=\"translate(";
+                positions.Write(sink, 2 * i);
+                sink << ' ';
+                positions.Write(sink, 2 * i + 1);
+                sink << ") scale(";
+                sizes.Write(sink, 2 * i);
+                if (sizes.At(2 * i) != sizes.At(2 * i + 1))
+                {
+                    sink << ' ';
+                    sizes.Write(sink, 2 * i + 1);
+                }
+                sink << ')';
+            }
+            sink << "\"/>";
+        }
+    }
+
+    void    WriteDefinition(Sink &sink) const
+    {
+        // the marker in the default size, or in unit size scaled by every <use>.
+        const bool  scaled = sizes.Size() != 0;
+        sink << "<g";
+        WriteAttributes(sink);
+        sink << ">\n  <defs><path id=\"";
+        sink.WriteEscaped(marker_id.data(), marker_id.size());
+        sink << "\" d=\"";
+        WriteMarker(sink, 0.0, 0.0, scaled ? 1.0 : width, scaled ? 1.0 : height);
+        sink << (scaled ? "\" vector-effect=\"non-scaling-stroke\"/></defs>" : "\"/></defs>");
+    }
+
+public:
+    MarkerBatch(const MarkerBatch&) = default;
+    MarkerBatch(MarkerBatch&&) = default;
+    MarkerBatch& operator=(const MarkerBatch&) = default;
+    MarkerBatch& operator=(MarkerBatch&&) = default;
+
+    MarkerBatch(const Path &marker, double size = 1.0)
+        : MarkerBatch(marker, size, size)
+    {}
+    MarkerBatch(const Path &marker, double width, double height)
+        : Base("path"),
+          marker(marker),
+          width(width),
+          height(height)
+    {
+        const auto  &commands = marker.Commands();
+        if (commands.empty() || commands[0] != 'M' || std::any_of(commands.begin() + 1, commands.end(), [](char c){return std::isupper(static_cast<unsigned char>(c)) != 0;}))
+        {
+            throw std::invalid_argument("simple_svg::MarkerBatch: the marker must be an 'M' followed by relative commands");
+        }
+    }
+    virtual ~MarkerBatch() override {}
+
+    static Path CircleMarker()  {return Path().Command('M', {-1, 0}).Command('a', {1, 1, 0, 1, 0, 2, 0}).Command('a', {1, 1, 0, 1, 0, -2, 0}).Command('z', {});}
+    static Path SquareMarker()  {return Path().Command('M', {-1, -1}).Command('h', {2}).Command('v', {2}).Command('h', {-2}).Command('z', {});}
+    static Path DiamondMarker() {return Path().Command('M', {0, -1}).Command('l', {1, 1}).Command('l', {-1, 1}).Command('l', {-1, -1}).Command('z', {});}
+
+    MarkerBatch&    Add(double x, double y)
+    /// Adds a copy of the default size at x, y.
+    {
+        return Add(x, y, width, height);
+    }
+
+    MarkerBatch&    Add(double x, double y, double width, double height)
+    {
+        if (sizes.Size() == 0 && (width != this->width || height != this->height))
+        {
+            // first copy of another size, every copy keeps its own from now on.
+            sizes.Store(positions.Kind(), positions.Decimals());
+            sizes.Reserve(positions.Size());
+            for (size_t i = 0; i < Count(); ++i)
+            {
+                sizes.Add(this->width);
+                sizes.Add(this->height);
+            }
+        }
+        positions.Add(x);
+        positions.Add(y);
+        if (sizes.Size() != 0)
+        {
+            sizes.Add(width);
+            sizes.Add(height);
+        }
+        return *this;
+    }
+
+    MarkerBatch&    Reserve(size_t count)
+    {
+        positions.Reserve(2 * count);
+        return *this;
+    }
+
+    MarkerBatch&    UseMarker(const std::string &id)
+    /// Writes the marker once as <path id="id"> in <defs> and a <use> per
+    /// copy instead of a single path. Copies of other than the default size
+    /// are scaled by a transform, keeping the stroke width.
+    {
+        marker_id = id;
+        return *this;
+    }
+
+    size_t  Count() const {return positions.Size() / 2;}
+    Point   At(size_t i) const {return {positions.At(2 * i), positions.At(2 * i + 1)};}
+
+    const Path&         Marker() const {return marker;}
+    const std::string&  MarkerId() const {return marker_id;}
+    double              DefaultWidth() const {return width;}
+    double              DefaultHeight() const {return height;}
+    const Coordinates&  Positions() const {return positions;}
+    const Coordinates&  Sizes() const {return sizes;}
+
+    MarkerBatch&    Assign(Coordinates positions, Coordinates sizes)
+    /// Replaces the copies, as given by Positions() and Sizes().
+    {
+        if (positions.Size() % 2 != 0 || (sizes.Size() != 0 && sizes.Size() != positions.Size()))
+        {
+            throw std::invalid_argument("simple_svg::MarkerBatch: positions and sizes do not match");
+        }
+        this->positions.Swap(positions);
+        this->sizes.Swap(sizes);
+        return *this;
+    }
+
+    Path    Combined() const
+    /// The copies as a single path, as written without UseMarker().
+    {
+        Path    path;
+        for (size_t i = 0; i < Count(); ++i)
+        {
+            ForEachCommand(positions.At(2 * i), positions.At(2 * i + 1), Width(i), Height(i), [&path](char command, const double *values)
+            {
+                path.Command(command, values);
+            });
+        }
+        return path;
+    }
+
+    virtual bool    ApplyTransform(const simple_svg::Transform &transform) override
+    {
+        if (!transform.IsAxisAligned() || transform.A() <= 0.0 || transform.D() <= 0.0)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < Count(); ++i)
+        {
+            const Point p = transform.Apply(At(i));
+            positions.Set(2 * i, p.X());
+            positions.Set(2 * i + 1, p.Y());
+        }
+        for (size_t i = 0; i < sizes.Size(); i += 2)
+        {
+            sizes.Set(i, sizes.At(i) * transform.A());
+            sizes.Set(i + 1, sizes.At(i + 1) * transform.D());
+        }
+        width *= transform.A();
+        height *= transform.D();
+        return true;
+    }
+
+    virtual MarkerBatch&    StoreAs(Storage storage, int decimals = 2) override
+    {
+        positions.Store(storage, decimals);
+        sizes.Store(storage, decimals);
+        return *this;
+    }
+
+    virtual void    Measure(Footprint &footprint) const override
+    {
+        Base::Measure(footprint);
+        footprint.objects += sizeof(MarkerBatch) - sizeof(Base) - sizeof(Path);
+        footprint.strings += heap_bytes(marker_id);
+        footprint.coordinates += positions.Bytes() + sizes.Bytes();
+
+        // the marker is part of this object, not an element of its own.
+        Footprint   path;
+        marker.Measure(path);
+        path.elements = 0;
+        footprint += path;
+    }
+
+    virtual MarkerBatch&    ShrinkToFit() override
+    {
+        Base::ShrinkToFit();
+        marker.ShrinkToFit();
+        marker_id.shrink_to_fit();
+        positions.ShrinkToFit();
+        sizes.ShrinkToFit();
+        return *this;
+    }
+
+    virtual void    Serialize(Sink &sink) const override
+    {
+        const Base  *child{nullptr};
+        for (size_t step = 0; SerializeStep(sink, step, child); ++step)
+        {
+        }
+    }
+
+    virtual bool    SerializeStep(Sink &sink, size_t step, const Base *&) const override
+    {
+        const size_t    steps = (Count() + markers_per_step - 1) / markers_per_step;
+        const size_t    first = step * markers_per_step;
+        const size_t    last = std::min(Count(), first + markers_per_step);
+        if (step == 0)
+        {
+            if (marker_id.empty())
+            {
+                sink << "<" << Tag() << " d=\"";
+            }
+            else
+            {
+                WriteDefinition(sink);
+            }
+        }
+        if (step < steps)
+        {
+            if (marker_id.empty())
+            {
+                WritePath(sink, first, last);
+            }
+            else
+            {
+                WriteUses(sink, first, last);
+            }
+            return true;
+        }
+
+        if (marker_id.empty())
+        {
+            sink << '"';
+            WriteAttributes(sink);
+            sink << "/>";
+        }
+        else
+        {
+            sink << "\n</g>";
+        }
+        return false;
+    }
+};
+
+class CircleBatch : public MarkerBatch
+{
+    // Circles of a common style, @see MarkerBatch.
+public:
+    CircleBatch(const CircleBatch&) = default;
+    CircleBatch(CircleBatch&&) = default;
+    CircleBatch& operator=(const CircleBatch&) = default;
+    CircleBatch& operator=(CircleBatch&&) = default;
+
+    CircleBatch(double radius = 1.0) : MarkerBatch(CircleMarker(), radius) {}
+    virtual ~CircleBatch() override {}
+
+    CircleBatch&    Add(double cx, double cy)
+    {
+        MarkerBatch::Add(cx, cy);
+        return *this;
+    }
+
+    CircleBatch&    Add(double cx, double cy, double radius)
+    {
+        MarkerBatch::Add(cx, cy, radius, radius);
+        return *this;
+    }
+
+    CircleBatch&    Add(const Point &center, double radius)
+    {
+        return Add(center.X(), center.Y(), radius);
+    }
+};
+
+class RectBatch : public MarkerBatch
+{
+    // Rectangles of a common style given by their top left corner, @see
+    // MarkerBatch.
+public:
+    RectBatch(const RectBatch&) = default;
+    RectBatch(RectBatch&&) = default;
+    RectBatch& operator=(const RectBatch&) = default;
+    RectBatch& operator=(RectBatch&&) = default;
+
+    RectBatch(double width = 1.0, double height = 1.0)
+        : MarkerBatch(Path().Command('M', {0, 0}).Command('h', {1}).Command('v', {1}).Command('h', {-1}).Command('z', {}), width, height)
+    {}
+    virtual ~RectBatch() override {}
+
+    RectBatch&  Add(double x, double y)
+    {
+        MarkerBatch::Add(x, y);
+        return *this;
+    }
+
+    RectBatch&  Add(double x, double y, double width, double height)
+    {
+        MarkerBatch::Add(x, y, width, height);
+        return *this;
+    }
+};
+
+//-----------------------------------------------------------------------------
+class LevelOfDetail;
+
+class GroupBase : public Base
+{
+    std::vector<std::shared_ptr<Base>>  objects;
+
+    struct Painting
+    {
+        bool    filled{true};
+        bool    stroked{true};
+        bool    capped{true};       ///< round or square line caps.
+        bool    marked{false};      ///< markers drawn at the vertices.
+    };
+
+    Painting    painting;           ///< inherited by the children, as of Clean().
+
+    void    BakeChildren(const simple_svg::Transform &transform, bool stroked, double stroke_width);
+    void    MergeChildren(bool filled, bool stroked, bool opaque, double stroke_width);
+    void    CleanChildren(const Painting &inherited);
+    bool    CleanChild(const std::shared_ptr<Base> &object);
+    static Painting Inherit(const Base &object, Painting painting);
+
+protected:
+    void    CollectDetail(std::vector<LevelOfDetail*> &details) const;
+
+protected:
+    bool    stores{false};              ///< whether appended elements are converted to storage.
+    bool    cleans{false};              ///< whether appended elements are cleaned, @see Clean().
+    Storage storage{Storage::Double};
+    int     decimals{2};
+
+    void    WriteStartTag(Sink &sink) const
+    {
+        sink << "<" << Tag();
+        WriteAttributes(sink);
+        sink << ">";
+    }
+
+    void    WriteEndTag(Sink &sink) const
+    {
+        sink << "</" << Tag() << ">";
+    }
+
+public:
+    GroupBase(const GroupBase&) = default;
+    GroupBase(GroupBase&&) = default;
+    GroupBase& operator=(const GroupBase&) = default;
+    GroupBase& operator=(GroupBase&&) = default;
+
+    GroupBase(std::string group_tag)
+        : Base(group_tag) {}
+    GroupBase(std::string group_tag, const std::vector<Attribute> &attributes)
+        : Base(group_tag, attributes) {}
+    virtual ~GroupBase() override {}
+
+    template<typename T>
+    GroupBase&  Append(const T& object)
+    {
+        return AppendShared(std::make_shared<T>(object));
+    }
+
+    GroupBase&  Clear()
+    /// Removes all children, keeping the allocated storage.
+    {
+        objects.clear();
+        return *this;
+    }
+
+    const auto&     Objects() const {return objects;}
+
+    GroupBase&  BakeTransforms();
+    GroupBase&  MergeShapes();
+    GroupBase&  SelectDetail(double scale);
+    GroupBase&  Clean();
+
+    GroupBase&  AppendShared(std::shared_ptr<Base> object)
+    /// Appends an already allocated element without copying it.
+    {
+        if (stores)
+        {
+            object->StoreAs(storage, decimals);
+        }
+        if (cleans && !CleanChild(object))
+        {
+            return *this;
+        }
+        objects.push_back(std::move(object));
+        return *this;
+    }
+
+    virtual void    Measure(Footprint &footprint) const override
+    {
+        Base::Measure(footprint);
+        footprint.objects += sizeof(GroupBase) - sizeof(Base);
+        footprint.children += objects.capacity() * sizeof(std::shared_ptr<Base>);
+    }
+
+    std::map<std::string, Footprint>    MeasureTree() const
+    /// The memory held by the element and its descendants by tag, "#text"
+    /// for character data. Elements shared by several parents are counted
+    /// once, with a control block each as allocated by std::make_shared.
+    {
+        std::map<std::string, Footprint>    footprints;
+        std::unordered_set<const Base*>     measured;
+        std::vector<const Base*>            pending{this};
+        measured.insert(this);
+        while (!pending.empty())
+        {
+            const Base  *element = pending.back();
+            pending.pop_back();
+
+            const std::string   tag = element->Tag();
+            Footprint           &footprint = footprints[tag.empty() ? "#text" : tag];
+            element->Measure(footprint);
+
+            const auto  *group = dynamic_cast<const GroupBase*>(element);
+            if (group == nullptr)
+            {
+                continue;
+            }
+            for (const auto &object : group->objects)
+            {
+                if (measured.insert(object.get()).second)
+                {
+                    // use and weak counts next to the pointer to the deleter table.
+                    const std::string   child_tag = object->Tag();
+                    footprints[child_tag.empty() ? "#text" : child_tag].control_blocks += sizeof(void*) + 2 * sizeof(int);
+                    pending.push_back(object.get());
+                }
+            }
+        }
+        return footprints;
+    }
+
+    Footprint   MeasureTotal() const
+    {
+        Footprint   total;
+        for (const auto &footprint : MeasureTree())
+        {
+            total += footprint.second;
+        }
+        return total;
+    }
+
+    virtual GroupBase&  ShrinkToFit() override
+    /// Releases unused capacity of the element and its descendants.
+    {
+        Base::ShrinkToFit();
+        objects.shrink_to_fit();
+        for (const auto &object : objects)
+        {
+            object->ShrinkToFit();
+        }
+        return *this;
+    }
+
+    virtual GroupBase&  StoreAs(Storage storage, int decimals = 2) override
+    /// Converts the coordinates of all descendants, and of elements appended
+    /// later, to storage.
+    {
+        for (const auto &object : objects)
+        {
+            object->StoreAs(storage, decimals);
+        }
+        stores = true;
+        this->storage = storage;
+        this->decimals = decimals;
+        return *this;
+    }
+
+    virtual void    Serialize(Sink &sink) const override
+    {
+        WriteStartTag(sink);
+        sink << '\n';
+
+        for (const auto &object : objects)
+        {
+            sink << "  ";
+            object->Serialize(sink);
+            sink << '\n';
+        }
+
+        WriteEndTag(sink);
+    }
+
+    virtual bool    SerializeStep(Sink &sink, size_t step, const Base *&child) const override
+    {
+        if (step == 0)
+        {
+            WriteStartTag(sink);
+            sink << '\n';
+        }
+        if (step < objects.size())
+        {
+            sink << (step != 0 ? "\n  " : "  ");
+            child = objects[step].get();
+            return true;
+        }
+
+        if (!objects.empty())
+        {
+            sink << '\n';
+        }
+        WriteEndTag(sink);
+        return false;
+    }
+};
+
+class Text : public GroupBase
+{
+    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/text
+
+    std::string text;
+    bool        escape{true};
+public:
+    Text(const Text&) = default;
+    Text(Text&&) = default;
+    Text& operator=(const Text&) = default;
+    Text& operator=(Text&&) = default;
+
+    Text(double x, double y, const std::string &text)
+        : GroupBase("text", {{"x",x},{"y",y}}),
+          text(text)
+    {}
+    Text(const Point &where, const std::string &text)
+        : GroupBase("text", {{"x",where.X()},{"y",where.Y()}}),
+          text(text)
+    {}
+    virtual ~Text() override {}
+
+    const std::string&  Content() const {return text;}
+    bool                Escape() const {return escape;}
+
+    virtual void    Measure(Footprint &footprint) const override
+    {
+        GroupBase::Measure(footprint);
+        footprint.objects += sizeof(Text) - sizeof(GroupBase);
+        footprint.strings += heap_bytes(text);
+    }
+
+    virtual Text&   ShrinkToFit() override
+    {
+        GroupBase::ShrinkToFit();
+        text.shrink_to_fit();
+        return *this;
+    }
+
+    virtual bool    RemoveRedundant(bool /*capped*/) override
+    {
+        return !text.empty() || !Objects().empty();
+    }
+
+    Text&   TextAnchor(const std::string &text_anchor)
+    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/text-anchor
+    {
+        AddAttribute({"text-anchor", text_anchor});
+        return *this;
+    }
+
+    Text&   Escape(bool escape)
+    /// Disables XML escaping of the text content when it is known to be safe.
+    {
+        this->escape = escape;
+        return *this;
+    }
+
+    Text&   Right() {return TextAnchor("start");}
+    Text&   Center() {return TextAnchor("middle");}
+    Text&   Left() {return TextAnchor("end");}
+
+    Text&   DominantBaseline(const std::string &dominant_baseline)
+    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/dominant-baseline
+    {
+        AddAttribute({"dominant-baseline", dominant_baseline});
+        return *this;
+    }
+
+    Text&   Auto() {return DominantBaseline("auto");}       ///< standard "on line" vertical alignment.
+    Text&   Middle() {return DominantBaseline("middle");}   ///< "centered" vertical alignment.
+    Text&   Hanging() {return DominantBaseline("hanging");} ///< "hangning" vertical alignment.
+
+    Text&   FontFamily(const std::string &font_family)
+    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/font-family
+    {
+        AddAttribute({"font-family", font_family});
+        return *this;
+    }
+
+    Text&   FontSize(const std::string &font_size)
+    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/font-size
+    {
+        AddAttribute({"font-size", font_size});
+        return *this;
+    }
+    Text&   FontSize(const double &font_size) {return FontSize(std::to_string(font_size) + "pt");}
+
+    Text&   FontStyle(const std::string &font_style)
+    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/font-style
+    {
+        AddAttribute({"font-style", font_style});
+        return *this;
+    }
+
+    Text&   FontWeight(const std::string &font_weight)
+    /// @see https://developer.mozilla.org/en-US/docs/Web/SVG/Attribute/font-weight
+    {
+        AddAttribute({"font-weight", font_weight});
+        return *this;
+    }
+
+    Text&   Bold() {return FontWeight("bold");}
+    Text&   Italic() {return FontStyle("italic");}
+    Text&   Oblique() {return FontStyle("italic");}
+    Text&   Normal() {return FontStyle("normal").FontWeight("normal");}
+
+    virtual void    Serialize(Sink &sink) const override
+    {
+        WriteStartTag(sink);
+        if (escape)
+        {
+            sink.WriteEscaped(text);
+        }
+        else
+        {
+            sink << text;
+        }
+        WriteEndTag(sink);
+    }
+
+    virtual bool    SerializeStep(Sink &sink, size_t step, const Base *&child) const override
+    {
+        return Base::SerializeStep(sink, step, child);
+    }
+};
+
+class CharacterData : public Base
+{
+    // Text content of an element without a dedicated class, e.g. of <title>
+    // or <style>, @see Element.
+    std::string text;
+    bool        escape{true};
+public:
+    CharacterData(const CharacterData&) = default;
+    CharacterData(CharacterData&&) = default;
+    CharacterData& operator=(const CharacterData&) = default;
+    CharacterData& operator=(CharacterData&&) = default;
+
+    CharacterData(const std::string &text, bool escape = true)
+        : Base(std::string()),
+          text(text),
+          escape(escape)
+    {}
+    virtual ~CharacterData() override {}
+
+    const std::string&  Content() const {return text;}
+    bool                Escape() const {return escape;}
+
+    virtual void    Measure(Footprint &footprint) const override
+    {
+        Base::Measure(footprint);
+        footprint.objects += sizeof(CharacterData) - sizeof(Base);
+        footprint.strings += heap_bytes(text);
+    }
+
+    virtual CharacterData&  ShrinkToFit() override
+    {
+        Base::ShrinkToFit();
+        text.shrink_to_fit();
+        return *this;
+    }
+
+    virtual void    Serialize(Sink &sink) const override
+    {
+        if (escape)
+        {
+            sink.WriteEscaped(text);
+        }
+        else
+        {
+            sink << text;
+        }
+    }
+};
+
+class Element : public GroupBase
+{
+    // Generic element for tags without a dedicated class, e.g. <defs>, <title>
+    // or the unknown tags read by simple_svg::Reader. Children are written
+    // without added white space when the element holds CharacterData, which
+    // keeps mixed content intact.
+    bool    Mixed() const
+    {
+        return std::any_of(Objects().begin(), Objects().end(), [](const auto &object){return dynamic_cast<const CharacterData*>(object.get()) != nullptr;});
+    }
+
+public:
+    Element(const Element&) = default;
+    Element(Element&&) = default;
+    Element& operator=(const Element&) = default;
+    Element& operator=(Element&&) = default;
+
+    Element(const std::string &tag) : GroupBase(tag) {}
+    Element(const std::string &tag, const std::vector<Attribute> &attributes) : GroupBase(tag, attributes) {}
+    virtual ~Element() override {}
+
+    virtual void    Serialize(Sink &sink) const override
+    {
+        if (!Mixed())
+        {
+            GroupBase::Serialize(sink);
+            return;
+        }
+
+        WriteStartTag(sink);
+        for (const auto &object : Objects())
+        {
+            object->Serialize(sink);
+        }
+        WriteEndTag(sink);
+    }
+
+    virtual bool    SerializeStep(Sink &sink, size_t step, const Base *&child) const override
+    {
+        return Mixed() ? Base::SerializeStep(sink, step, child) : GroupBase::SerializeStep(sink, step, child);
+    }
+};
+
+class Group : public GroupBase
+{
+    // https://developer.mozilla.org/en-US/docs/Web/SVG/Element/g
+public:
+    Group(const Group&) = default;
+    Group(Group&&) = default;
+    Group& operator=(const Group&) = default;
+    Group& operator=(Group&&) = default;
+
+    Group() : GroupBase("g") {}
+    virtual ~Group() override {}
+};
+
+class Layer : public GroupBase
+{
+    // Implemented as Inkscape layer based on a group, <g>, with special attributes.
+public:
+    Layer(const Layer&) = default;
+    Layer(Layer&&) = default;
+    Layer& operator=(const Layer&) = default;
+    Layer& operator=(Layer&&) = default;
+
+    Layer()
+        : GroupBase("g", {{"inkscape:groupmode", std::string("layer"), false}})
+    {}
+    Layer(const std::string &name)
+        : GroupBase("g", {{"inkscape:label", name}, {"inkscape:groupmode", std::string("layer"), false}})
+    {}
+    virtual ~Layer() override {}
+};
+
+class LevelOfDetail : public GroupBase
+{
+    // Alternative versions of one drawing, e.g. a full path, a simplified
+    // path and a bounding box, each drawn from a minimum zoom on, in output
+    // pixels per user unit of the document. Written is the level selected by
+    // GroupBase::SelectDetail() for a known output resolution, the most
+    // detailed one by default, or with Document::ResponsiveDetail() every
+    // level in a <g> shown by CSS media queries on the viewport width.
+    //
+    //  simple_svg::LevelOfDetail   coast;
+    //  coast.Level(0.0, outline).Level(0.5, simplified).Level(4.0, full);
+    //  document.Append(coast);
+    //  document.SelectDetail(1024.0 / map_width);
+    static constexpr size_t npos{static_cast<size_t>(-1)};
+
+    std::vector<double>                 scales;     ///< minimum zoom of every level.
+    size_t                              selected{npos};
+    std::vector<std::pair<long, long>>  widths;     ///< viewport widths showing every level when written responsively, -1 for no limit.
+
+    double  Scale(size_t i) const {return i < scales.size() ? scales[i] : 0.0;}
+
+    std::string ClassName(size_t i) const
+    {
+        const auto  &range = widths[i];
+        return "lod-" + std::to_string(range.first) + (range.second < 0 ? std::string("-up") : "-" + std::to_string(range.second));
+    }
+
+public:
+    LevelOfDetail(const LevelOfDetail&) = default;
+    LevelOfDetail(LevelOfDetail&&) = default;
+    LevelOfDetail& operator=(const LevelOfDetail&) = default;
+    LevelOfDetail& operator=(LevelOfDetail&&) = default;
+
+    LevelOfDetail() : GroupBase("g") {}
+    virtual ~LevelOfDetail() override {}
+
+    template<typename T>
+    LevelOfDetail&  Level(double scale, const T &level)
+    /// Adds a level drawn at scale output pixels per user unit and more.
+    {
+        return LevelShared(scale, std::make_shared<T>(level));
+    }
+
+    LevelOfDetail&  LevelShared(double scale, std::shared_ptr<Base> level)
+    {
+        scales.resize(Objects().size());
+        scales.push_back(scale);
+        AppendShared(std::move(level));
+        return *this;
+    }
+
+    const std::vector<double>&                  Scales() const {return scales;}
+    size_t                                      Selected() const {return selected;}    ///< the level set by Select(), -1 if none.
+    const std::vector<std::pair<long, long>>&   Widths() const {return widths;}
+
+    LevelOfDetail&  Assign(std::vector<double> level_scales, size_t level, std::vector<std::pair<long, long>> level_widths)
+    /// Restores what Scales(), Selected() and Widths() returned for the levels
+    /// appended since, e.g. by simple_svg::Binary.
+    {
+        scales = std::move(level_scales);
+        selected = level;
+        widths = std::move(level_widths);
+        if (widths.size() != Objects().size())
+        {
+            widths.clear();
+        }
+        return *this;
+    }
+
+    size_t  LevelAt(double scale) const
+    /// Index of the level drawn at scale, the one of the largest minimum not
+    /// above scale, or the coarsest level if all are above.
+    {
+        size_t  best{npos};
+        size_t  coarsest{npos};
+        for (size_t i = 0; i < Objects().size(); ++i)
+        {
+            if (Scale(i) <= scale && (best == npos || Scale(i) >= Scale(best)))
+            {
+                best = i;
+            }
+            if (coarsest == npos || Scale(i) < Scale(coarsest))
+            {
+                coarsest = i;
+            }
+        }
+        return best != npos ? best : coarsest;
+    }
+
+    LevelOfDetail&  Select(double scale)
+    /// Writes only the level drawn at scale.
+    {
+        selected = LevelAt(scale);
+        widths.clear();
+        return *this;
+    }
+
+    LevelOfDetail&  Responsive(double view_box_width)
+    /// Writes all levels, each in a <g> with a class shown by the CSS of
+    /// StyleRules() for the viewport widths its zoom applies to, @see
+    /// Document::ResponsiveDetail().
+    {
+        widths.assign(Objects().size(), {0, -1});
+        const size_t    coarsest = LevelAt(-std::numeric_limits<double>::infinity());
+        for (size_t i = 0; i < Objects().size(); ++i)
+        {
+            // shown from its zoom up to the next larger one.
+            double  next{std::numeric_limits<double>::infinity()};
+            for (size_t k = 0; k < Objects().size(); ++k)
+            {
+                if (Scale(k) > Scale(i) || (Scale(k) == Scale(i) && k > i))
+                {
+                    next = std::min(next, Scale(k));
+                }
+            }
+            widths[i].first = i == coarsest ? 0 : std::lround(Scale(i) * view_box_width);
+            widths[i].second = std::isinf(next) ? -1 : std::lround(next * view_box_width);
+        }
+        return *this;
+    }
+
+    std::vector<std::string>    StyleRules() const
+    /// The CSS rules for the classes set by Responsive().
+    {
+        std::vector<std::string>    rules;
+        for (size_t i = 0; i < widths.size(); ++i)
+        {
+            const long  from = widths[i].first;
+            const long  to = widths[i].second;
+            if (from == 0 && to < 0)
+            {
+                continue;
+            }
+
+            const std::string   name = ClassName(i);
+            std::string         rule = "." + name + "{display:none}@media ";
+            if (from != 0)
+            {
+                rule += "(min-width:" + std::to_string(from) + "px)" + (to >= 0 ? " and " : "");
+            }
+            if (to >= 0)
+            {
+                rule += "(max-width:" + to_string(static_cast<double>(to) - 0.01) + "px)";
+            }
+            rules.push_back(rule + "{." + name + "{display:inline}}");
+        }
+        return rules;
+    }
+
+    virtual void    Serialize(Sink &sink) const override
+    {
+        const Base  *child{nullptr};
+        for (size_t step = 0;; ++step)
+        {
+            child = nullptr;
+            const bool  more = SerializeStep(sink, step, child);
+            if (child != nullptr)
+            {
+                child->Serialize(sink);
+            }
+            if (!more)
+            {
+                break;
+            }
+        }
+    }
+
+    virtual bool    SerializeStep(Sink &sink, size_t step, const Base *&child) const override
+    {
+        const size_t    count = Objects().size();
+        if (count == 0)
+        {
+            return GroupBase::SerializeStep(sink, step, child);
+        }
+
+        if (widths.size() == count)
+        {
+            sink << (step == 0 ? "" : "</g>\n");
+            if (step == 0)
+            {
+                WriteStartTag(sink);
+                sink << '\n';
+            }
+            if (step < count)
+            {
+                sink << "  <g class=\"" << ClassName(step) << "\">";
+                child = Objects()[step].get();
+                return true;
+            }
+            WriteEndTag(sink);
+            return false;
+        }
+
+        // a single level, in a <g> only for attributes of its own.
+        const bool  wrapped = !Attributes().empty();
+        if (step == 0)
+        {
+            if (wrapped)
+            {
+                WriteStartTag(sink);
+                sink << "\n  ";
+            }
+            child = Objects()[selected < count ? selected : LevelAt(std::numeric_limits<double>::infinity())].get();
+            return true;
+        }
+        if (wrapped)
+        {
+            sink << '\n';
+            WriteEndTag(sink);
+        }
+        return false;
+    }
+};
+
+class Document : public GroupBase
+{
+    std::shared_ptr<Element>    detail_style;   ///< <style> of ResponsiveDetail().
+
+public:
+    Document(const Document&) = default;
+    Document(Document&&) = default;
+    Document& operator=(const Document&) = default;
+    Document& operator=(Document&&) = default;
+
+    //<?xml version="1.0"?>
+    //<svg width="100" height="100" xmlns="http://www.w3.org/2000/svg">
+    //</svg>
+    Document()
+        : GroupBase(
+              "svg",
+    {{"xmlns", std::string("http://www.w3.org/2000/svg"), false},
+    {"xmlns:xlink", std::string("http://www.w3.org/1999/xlink"), false},
+    {"xmlns:inkscape",std::string("http://www.inkscape.org/namespaces/inkscape"), false}})
+    {}
+    Document(double width, double height)
+        : GroupBase(
+              "svg",
+    {{"width",width},
+    {"height",height},
+    {"xmlns", std::string("http://www.w3.org/2000/svg"), false},
+    {"xmlns:xlink", std::string("http://www.w3.org/1999/xlink"), false},
+    {"xmlns:inkscape",std::string("http://www.inkscape.org/namespaces/inkscape"), false}})
+    {}
+    virtual ~Document() override {}
+
+    Document&   Reset()
+    /// Restores the state of Document(), keeping the allocated storage for reuse.
+    {
+        Clear();
+        ClearAttributes();
+        stores = false;
+        cleans = false;
+        detail_style.reset();
+        AddAttribute({"xmlns", std::string("http://www.w3.org/2000/svg"), false});
+        AddAttribute({"xmlns:xlink", std::string("http://www.w3.org/1999/xlink"), false});
+        AddAttribute({"xmlns:inkscape",std::string("http://www.inkscape.org/namespaces/inkscape"), false});
+
+        return *this;
+    }
+
+    Document&   Size(double width, double height)
+    {
+        AddAttribute({"width", width});
+        AddAttribute({"height", height});
+
+        return *this;
+    }
+
+    Document&   ViewBox(double x_min, double y_min, double width, double height)
+    {
+        std::ostringstream  stream;
+        stream << x_min << ' ' << y_min << ' ' << width << ' ' << height;
+        AddAttribute({"viewBox", stream.str(), false});
+
+        return *this;
+    }
+
+    bool    GetViewBox(double *box) const
+    /// Reads x_min, y_min, width and height of the viewBox attribute into
+    /// box[0..3]. Returns false if there is none or it is malformed.
+    {
+        const auto  *view_box = FindAttribute("viewBox");
+        if (view_box == nullptr)
+        {
+            return false;
+        }
+
+        const std::string   text = view_box->Value();
+        const char          *p = text.data();
+        const char          *last = text.data() + text.size();
+        for (size_t i = 0; i < 4; ++i)
+        {
+            while (p != last && (std::isspace(static_cast<unsigned char>(*p)) || *p == ','))
+            {
+                ++p;
+            }
+            const char  *start = p;
+            p = parse_number(p, last, box[i]);
+            if (p == start)
+            {
+                return false;
+            }
+        }
+        return box[2] > 0.0 && box[3] > 0.0;
+    }
+
+    Document&   ResponsiveDetail()
+    /// Makes every LevelOfDetail write all its levels, shown by CSS media
+    /// queries on the viewport width, for viewers that zoom by resizing the
+    /// image, e.g. an <img>. The rules go into a <style> appended on the first
+    /// call and updated by later ones. Needs a viewBox.
+    {
+        double  box[4];
+        if (!GetViewBox(box) || box[2] <= 0.0)
+        {
+            throw std::logic_error("simple_svg::Document: responsive detail needs a viewBox");
+        }
+
+        std::vector<LevelOfDetail*> details;
+        CollectDetail(details);
+        std::vector<std::string>    rules;
+        for (auto *detail : details)
+        {
+            detail->Responsive(box[2]);
+            const auto  detail_rules = detail->StyleRules();
+            rules.insert(rules.end(), detail_rules.begin(), detail_rules.end());
+        }
+        std::sort(rules.begin(), rules.end());
+        rules.erase(std::unique(rules.begin(), rules.end()), rules.end());
+
+        std::string text;
+        for (const auto &rule : rules)
+        {
+            text += rule + '\n';
+        }
+        if (!detail_style)
+        {
+            detail_style = std::make_shared<Element>("style");
+            AppendShared(detail_style);
+        }
+        detail_style->Clear();
+        detail_style->Append(CharacterData(text, false));
+        return *this;
+    }
+
+    virtual void    Serialize(Sink &sink) const override
+    {
+        sink << "<?xml version=\"1.0\"?>" << '\n';
+
+        GroupBase::Serialize(sink);
+    }
+
+    virtual bool    SerializeStep(Sink &sink, size_t step, const Base *&child) const override
+    {
+        if (step == 0)
+        {
+            sink << "<?xml version=\"1.0\"?>" << '\n';
+        }
+
+        return GroupBase::SerializeStep(sink, step, child);
+    }
+};
+
+//-----------------------------------------------------------------------------
+inline GroupBase&   GroupBase::BakeTransforms()
+/// Applies the transforms of all descendants, and of the groups containing
+/// them, directly to their geometry and removes the transform attributes.
+/// Elements that cannot represent their transformed geometry, e.g. Text, Use
+/// or a rotated Rect, get a single combined transform instead. Stroke widths
+/// are scaled along as given by the attributes of the element and its
+/// ancestors; CSS styling is not considered. Children shared with copies of
+/// the group are changed in place.
+{
+    const auto  *stroke = FindAttribute("stroke");
+    BakeChildren(simple_svg::Transform(), stroke != nullptr && stroke->Value() != "none", NumericAttribute("stroke-width", 1.0));
+    return *this;
+}
+
+inline void GroupBase::BakeChildren(const simple_svg::Transform &parent, bool stroked, double stroke_width)
+{
+    auto    references = [](const Base &object)
+    {
+        // clip paths, masks, filters and paint servers depend on the user space.
+        const auto  &attributes = object.Attributes();
+        return std::any_of(attributes.begin(), attributes.end(), [](const Attribute &a){return a.Value().find("url(") != std::string::npos;});
+    };
+
+    for (auto &object : objects)
+    {
+        const simple_svg::Transform transform = parent * object->GetTransform();
+        const auto      *stroke = object->FindAttribute("stroke");
+        const bool      object_stroked = stroke != nullptr ? stroke->Value() != "none" : stroked;
+        const double    object_stroke_width = object->NumericAttribute("stroke-width", stroke_width);
+
+        auto    group = std::dynamic_pointer_cast<GroupBase>(object);
+        if (group && !std::dynamic_pointer_cast<Text>(object) && (group->Tag() == "g" || group->Tag() == "a") && !references(*group))
+        {
+            group->RemoveAttribute("transform");
+            group->BakeChildren(transform, object_stroked, object_stroke_width);
+            continue;
+        }
+
+        double      scale{};
+        const bool  similar = transform.IsSimilarity(scale);
+        const bool  scaled = std::fabs(scale - 1.0) > 1e-9;
+        const bool  bakeable = !object_stroked || (similar && (!scaled || object->FindAttribute("stroke-dasharray") == nullptr));
+        if (!group && bakeable && !references(*object) && object->ApplyTransform(transform))
+        {
+            object->RemoveAttribute("transform");
+            if (object_stroked && scaled)
+            {
+                object->StrokeWidth(object_stroke_width * scale);
+            }
+            continue;
+        }
+
+        object->Transform(transform);
+        if (group)
+        {
+            group->BakeChildren(simple_svg::Transform(), object_stroked, object_stroke_width);
+        }
+    }
+}
+
+inline void GroupBase::CollectDetail(std::vector<LevelOfDetail*> &details) const
+{
+    for (const auto &object : objects)
+    {
+        if (auto detail = dynamic_cast<LevelOfDetail*>(object.get()))
+        {
+            details.push_back(detail);
+        }
+        if (auto group = dynamic_cast<const GroupBase*>(object.get()))
+        {
+            group->CollectDetail(details);
+        }
+    }
+}
+
+inline GroupBase&   GroupBase::SelectDetail(double scale)
+/// Makes every LevelOfDetail below write only its level for an output of
+/// scale pixels per user unit, e.g. the output width over the width of the
+/// viewBox.
+{
+    std::vector<LevelOfDetail*> details;
+    CollectDetail(details);
+    for (auto *detail : details)
+    {
+        detail->Select(scale);
+    }
+    return *this;
+}
+
+inline GroupBase&   GroupBase::Clean()
+/// Removes redundant geometry from all descendants in "g" and "a" elements,
+/// @see Base::RemoveRedundant(), and drops the elements drawing nothing:
+/// empty geometry, zero opacity, display="none", or shapes neither filled
+/// nor stroked as given by their attributes and those of their ancestors.
+/// Elements appended later are cleaned as they are appended, so that a
+/// document streamed out by parts never holds them. Elements with an id,
+/// class or style, and those drawing markers, are kept unchanged, as are
+/// empty layers. A group other than a Document is assumed to inherit a fill,
+/// a stroke and round line caps. Children shared with copies of the group
+/// are changed in place.
+{
+    Painting    root;
+    if (dynamic_cast<Document*>(this) != nullptr)
+    {
+        root = {true, false, false, false};
+    }
+    CleanChildren(root);
+    return *this;
+}
+
+inline GroupBase::Painting  GroupBase::Inherit(const Base &object, Painting painting)
+/// The paint of object, a child of an element painting as given.
+{
+    auto    paint = [&object](const char *name, bool &painted)
+    {
+        const auto  *attribute = object.FindAttribute(name);
+        if (attribute != nullptr)
+        {
+            painted = attribute->Value() != "none" && attribute->Value() != "transparent";
+        }
+        if (object.NumericAttribute(std::string(name) + "-opacity", 1.0) <= 0.0)
+        {
+            painted = false;
+        }
+    };
+    paint("fill", painting.filled);
+    paint("stroke", painting.stroked);
+    if (object.NumericAttribute("stroke-width", 1.0) <= 0.0)
+    {
+        painting.stroked = false;
+    }
+    const auto  *linecap = object.FindAttribute("stroke-linecap");
+    if (linecap != nullptr)
+    {
+        painting.capped = linecap->Value() != "butt";
+    }
+    painting.marked = painting.marked || object.FindAttribute("marker") != nullptr || object.FindAttribute("marker-start") != nullptr
+                   || object.FindAttribute("marker-mid") != nullptr || object.FindAttribute("marker-end") != nullptr;
+    return painting;
+}
+
+inline void GroupBase::CleanChildren(const Painting &inherited)
+{
+    painting = Inherit(*this, inherited);
+    cleans = true;
+
+    size_t  kept{0};
+    for (auto &object : objects)
+    {
+        if (CleanChild(object))
+        {
+            objects[kept++] = std::move(object);
+        }
+    }
+    objects.resize(kept);
+}
+
+inline bool GroupBase::CleanChild(const std::shared_ptr<Base> &object)
+/// Cleans object, a child of the group, and returns whether to keep it.
+{
+    // the levels of a LevelOfDetail stay in place, even if empty.
+    const bool  levels = dynamic_cast<LevelOfDetail*>(this) != nullptr;
+    if (object->FindAttribute("id") != nullptr || object->FindAttribute("class") != nullptr || object->FindAttribute("style") != nullptr)
+    {
+        return true;
+    }
+    const auto  *display = object->FindAttribute("display");
+    if (object->NumericAttribute("opacity", 1.0) <= 0.0 || (display != nullptr && display->Value() == "none"))
+    {
+        return levels;
+    }
+
+    auto    group = std::dynamic_pointer_cast<GroupBase>(object);
+    if (group && !std::dynamic_pointer_cast<Text>(object) && (group->Tag() == "g" || group->Tag() == "a" || group->Tag() == "svg"))
+    {
+        group->CleanChildren(painting);
+        return levels || !group->objects.empty() || group->FindAttribute("inkscape:groupmode") != nullptr;
+    }
+
+    const Painting  paint = Inherit(*object, painting);
+    if (paint.marked)
+    {
+        return true;
+    }
+
+    const std::string   tag = object->Tag();
+    const bool          shape = tag == "rect" || tag == "circle" || tag == "ellipse" || tag == "line" || tag == "polyline"
+                             || tag == "polygon" || tag == "path" || tag == "text";
+    const bool          draws = object->RemoveRedundant(paint.capped) && (!shape || (paint.filled && tag != "line") || paint.stroked);
+    return levels || draws;
+}
+
+inline GroupBase&   GroupBase::MergeShapes()
+/// Replaces runs of consecutive sibling Line, Polyline, Polygon, Rect and
+/// Path elements of identical attributes, FixedLine and FixedRect included,
+/// by one Path each, in all "g" and "a" descendants. Opaque elements painting only a stroke merge freely;
+/// filled or translucent ones only while the area they paint, stroke
+/// included, does not overlap that of the run so far, which keeps the fill
+/// rule and paint order intact. Elements with an id, markers or url()
+/// references are kept, as are CSS styled ones unless disjoint.
+{
+    const auto  *fill = FindAttribute("fill");
+    const auto  *stroke = FindAttribute("stroke");
+    MergeChildren(fill == nullptr || fill->Value() != "none", stroke != nullptr && stroke->Value() != "none",
+                  NumericAttribute("fill-opacity", 1.0) >= 1.0 && NumericAttribute("stroke-opacity", 1.0) >= 1.0 && FindAttribute("style") == nullptr && FindAttribute("class") == nullptr,
+                  NumericAttribute("stroke-width", 1.0));
+    return *this;
+}
+
+inline void GroupBase::MergeChildren(bool filled, bool stroked, bool opaque, double stroke_width)
+{
+    struct Box
+    {
+        double  x0{std::numeric_limits<double>::max()};
+        double  y0{std::numeric_limits<double>::max()};
+        double  x1{std::numeric_limits<double>::lowest()};
+        double  y1{std::numeric_limits<double>::lowest()};
+
+        void    Add(const Point &p)
+        {
+            x0 = std::min(x0, p.X());
+            y0 = std::min(y0, p.Y());
+            x1 = std::max(x1, p.X());
+            y1 = std::max(y1, p.Y());
+        }
+        void    Unite(const Box &box)
+        {
+            Add({box.x0, box.y0});
+            Add({box.x1, box.y1});
+        }
+        bool    Overlaps(const Box &box, double margin) const
+        {
+            return x0 - margin < box.x1 && box.x0 - margin < x1 && y0 - margin < box.y1 && box.y0 - margin < y1;
+        }
+    };
+
+    struct Candidate
+    {
+        std::vector<Attribute>  attributes;     ///< without the geometry, in document order.
+        std::vector<std::string> key;           ///< the attributes as name=value, sorted.
+        Path                    path;
+        Box                     box;
+        bool                    free{false};    ///< merges regardless of overlap.
+        double                  margin{0.0};
+    };
+
+    auto    number = [](const Base &object, const char *name, double &value)
+    {
+        const auto  *attribute = object.FindAttribute(name);
+        const std::string   text = attribute != nullptr ? attribute->Value() : std::string("0");
+        return parse_number(text.data(), text.data() + text.size(), value) == text.data() + text.size() && !text.empty();
+    };
+    auto    translucent = [](const std::string &colour)
+    {
+        return colour == "transparent" || colour.find("rgba") != std::string::npos || colour.find("hsla") != std::string::npos ||
+               (colour.size() > 0 && colour[0] == '#' && (colour.size() == 5 || colour.size() == 9));
+    };
+
+    auto    candidate = [&](const Base &object, Candidate &c)
+    {
+        static const char *const    geometry_names[] = {"x", "y", "width", "height", "x1", "y1", "x2", "y2"};
+        const bool  rect = dynamic_cast<const Rect*>(&object) != nullptr;
+        const bool  line = dynamic_cast<const Line*>(&object) != nullptr;
+        const auto  *poly = dynamic_cast<const PolyBase*>(&object);
+        const auto  *path = dynamic_cast<const Path*>(&object);
+        if (!rect && !line && poly == nullptr && path == nullptr)
+        {
+            return false;
+        }
+
+        bool    element_filled = filled && !line;
+        bool    element_stroked = stroked;
+        bool    element_opaque = opaque;
+        double  element_stroke_width = stroke_width;
+        for (const auto &attribute : object.Attributes())
+        {
+            const std::string   &name = attribute.Name();
+            const std::string   value = attribute.Value();
+            if (name == "id" || name.compare(0, 6, "marker") == 0 || value.find("url(") != std::string::npos || value.find("marker") != std::string::npos ||
+                (rect && (name == "rx" || name == "ry")))
+            {
+                return false;
+            }
+            if (std::find(std::begin(geometry_names), std::end(geometry_names), name) != std::end(geometry_names) && (rect || line))
+            {
+                continue;
+            }
+
+            if      (name == "fill")            element_filled = !line && value != "none";
+            else if (name == "stroke")          element_stroked = value != "none";
+            else if (name == "stroke-width")    element_stroke_width = to_number(value, 1.0);
+            else if (name == "style" || name == "class" || ((name == "opacity" || name == "fill-opacity" || name == "stroke-opacity") && to_number(value, 1.0) < 1.0))
+            {
+                element_opaque = false;
+            }
+            if ((name == "fill" || name == "stroke") && translucent(value))
+            {
+                element_opaque = false;
+            }
+
+            c.attributes.push_back(attribute);
+            c.key.push_back(name + '=' + value);
+        }
+        std::sort(c.key.begin(), c.key.end());
+
+        double  v[4];
+        if (rect)
+        {
+            if (!number(object, "x", v[0]) || !number(object, "y", v[1]) || !number(object, "width", v[2]) || !number(object, "height", v[3]) || v[2] <= 0.0 || v[3] <= 0.0)
+            {
+                return false;
+            }
+            c.path.Command('M', {v[0], v[1]}).Command('h', {v[2]}).Command('v', {v[3]}).Command('h', {-v[2]}).Command('z', {});
+            c.box.Add({v[0], v[1]});
+            c.box.Add({v[0] + v[2], v[1] + v[3]});
+        }
+        else if (line)
+        {
+            if (!number(object, "x1", v[0]) || !number(object, "y1", v[1]) || !number(object, "x2", v[2]) || !number(object, "y2", v[3]))
+            {
+                return false;
+            }
+            c.path.Command('M', {v[0], v[1]}).Command('L', {v[2], v[3]});
+            c.box.Add({v[0], v[1]});
+            c.box.Add({v[2], v[3]});
+        }
+        else if (poly != nullptr)
+        {
+            if (poly->Count() == 0)
+            {
+                return false;
+            }
+            for (size_t i = 0; i < poly->Count(); ++i)
+            {
+                const Point p = poly->At(i);
+                c.path.Command(i == 0 ? 'M' : 'L', {p.X(), p.Y()});
+                c.box.Add(p);
+            }
+            if (dynamic_cast<const Polygon*>(poly) != nullptr)
+            {
+                c.path.Command('Z', {});
+            }
+        }
+        else
+        {
+            // control points bound the curves, arcs are bounded around their chord.
+            const auto  &commands = path->Commands();
+            Point       current;
+            Point       start;
+            size_t      offset{0};
+            for (size_t i = 0; i < commands.size(); ++i)
+            {
+                const char      command = (i == 0 && commands[i] == 'm') ? 'M' : commands[i];
+                const size_t    count = Path::ArgumentCount(command);
+                const bool      relative = std::islower(static_cast<unsigned char>(command)) != 0;
+                const char      upper = static_cast<char>(std::toupper(static_cast<unsigned char>(command)));
+                double          a[7];
+                path->Arguments().Copy(offset, count, a);
+                offset += count;
+                c.path.Command(command, a);
+
+                const Point origin = relative ? current : Point();
+                Point       next = current;
+                if      (upper == 'H')  next = Point(origin.X() + a[0], current.Y());
+                else if (upper == 'V')  next = Point(current.X(), (relative ? current.Y() : 0.0) + a[0]);
+                else if (upper == 'Z')  next = start;
+                else if (upper == 'A')
+                {
+                    next = origin + Point(a[5], a[6]);
+                    const double    reach = 2.0 * std::max({std::fabs(a[0]), std::fabs(a[1]), (next - current).Length() / 2.0});
+                    const Point     middle = (current + next) / 2.0;
+                    c.box.Add(middle - Point(reach, reach));
+                    c.box.Add(middle + Point(reach, reach));
+                }
+                else if (count != 0)
+                {
+                    for (size_t k = 0; k + 1 < count; k += 2)
+                    {
+                        c.box.Add(origin + Point(a[k], a[k + 1]));
+                    }
+                    next = origin + Point(a[count - 2], a[count - 1]);
+                }
+                c.box.Add(current);
+                c.box.Add(next);
+                current = next;
+                if (upper == 'M')
+                {
+                    start = current;
+                }
+            }
+            if (commands.empty())
+            {
+                return false;
+            }
+        }
+
+        c.free = !element_filled && element_opaque;
+        c.margin = element_stroked ? 2.0 * element_stroke_width : 0.0;    // miter joins reach up to twice the stroke width.
+        return true;
+    };
+
+    std::vector<std::shared_ptr<Base>>  merged;
+    merged.reserve(objects.size());
+
+    Candidate   run;
+    size_t      run_first{0};
+    size_t      run_size{0};
+    bool        run_free{true};
+    auto    flush = [&](size_t end)
+    {
+        if (run_size > 1)
+        {
+            auto    path = std::make_shared<Path>(std::move(run.path));
+            for (const auto &attribute : run.attributes)
+            {
+                path->AddAttribute(attribute);
+            }
+            if (stores)
+            {
+                path->StoreAs(storage, decimals);
+            }
+            merged.push_back(std::move(path));
+        }
+        else
+        {
+            merged.insert(merged.end(), objects.begin() + static_cast<std::ptrdiff_t>(run_first), objects.begin() + static_cast<std::ptrdiff_t>(end));
+        }
+        run = Candidate();
+        run_first = end;
+        run_size = 0;
+        run_free = true;
+    };
+
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        const auto  &object = objects[i];
+        auto        group = std::dynamic_pointer_cast<GroupBase>(object);
+        if (group)
+        {
+            flush(i);
+            if (!std::dynamic_pointer_cast<Text>(object) && (group->Tag() == "g" || group->Tag() == "a"))
+            {
+                const auto  *fill = group->FindAttribute("fill");
+                const auto  *stroke = group->FindAttribute("stroke");
+                const auto  *style = group->FindAttribute("style");
+                const auto  *css_class = group->FindAttribute("class");
+                group->MergeChildren(fill != nullptr ? fill->Value() != "none" : filled,
+                                     stroke != nullptr ? stroke->Value() != "none" : stroked,
+                                     opaque && style == nullptr && css_class == nullptr && group->NumericAttribute("fill-opacity", 1.0) >= 1.0 && group->NumericAttribute("stroke-opacity", 1.0) >= 1.0,
+                                     group->NumericAttribute("stroke-width", stroke_width));
+            }
+            merged.push_back(object);
+            run_first = i + 1;
+            continue;
+        }
+
+        // fixed elements are matched by their expansion, and kept as such when not merged.
+        const auto  *fixed = dynamic_cast<const FixedBase*>(object.get());
+        const auto  shape = fixed != nullptr ? fixed->Expand() : object;
+        Candidate   c;
+        if (dynamic_cast<const LevelOfDetail*>(this) != nullptr || !candidate(*shape, c))
+        {
+            flush(i);
+            merged.push_back(object);
+            run_first = i + 1;
+            continue;
+        }
+
+        const bool  joins = run_size != 0 && c.key == run.key && ((c.free && run_free) || !run.box.Overlaps(c.box, std::max(c.margin, run.margin)));
+        if (!joins)
+        {
+            flush(i);
+            run = std::move(c);
+            run_size = 1;
+            run_free = run.free;
+            continue;
+        }
+
+        // append the geometry of c to the run.
+        const auto  &commands = c.path.Commands();
+        size_t      offset{0};
+        for (const char command : commands)
+        {
+            double  a[7];
+            c.path.Arguments().Copy(offset, Path::ArgumentCount(command), a);
+            offset += Path::ArgumentCount(command);
+            run.path.Command(command, a);
+        }
+        run.box.Unite(c.box);
+        run.margin = std::max(run.margin, c.margin);
+        run_free = run_free && c.free;
+        ++run_size;
+    }
+    flush(objects.size());
+
+    objects.swap(merged);
+}
+
+//-----------------------------------------------------------------------------
+class ConcurrentAppender
+{
+    // Collects the elements of a group from several producer threads. Each
+    // producer appends to its own Local buffer without locking, the buffer is
+    // handed over under a lock once, when the Local is destroyed or flushed.
+    // Commit() then appends everything to the group: sorted by the producer
+    // supplied keys when ordered, which makes the output deterministic for
+    // unique keys, otherwise buffer by buffer in hand over order.
+    struct Entry
+    {
+        uint64_t                key;
+        std::shared_ptr<Base>   object;
+    };
+
+    GroupBase           &group;
+    bool                ordered;
+    std::mutex          mutex;
+    std::vector<Entry>  entries;
+
+    void    Merge(std::vector<Entry> &local)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (entries.empty())
+        {
+            entries.swap(local);
+        }
+        else
+        {
+            entries.insert(entries.end(), std::make_move_iterator(local.begin()), std::make_move_iterator(local.end()));
+        }
+        local.clear();
+    }
+
+public:
+    class Local
+    {
+        ConcurrentAppender  *owner;
+        std::vector<Entry>  entries;
+    public:
+        Local(const Local&) = delete;
+        Local& operator=(const Local&) = delete;
+
+        explicit Local(ConcurrentAppender &owner) : owner(&owner) {}
+        Local(Local &&other) : owner(other.owner), entries(std::move(other.entries)) {other.owner = nullptr;}
+        ~Local() {Flush();}
+
+        template<typename T>
+        Local&  Append(const T &object, uint64_t key = 0)
+        {
+            entries.push_back({key, std::make_shared<T>(object)});
+            return *this;
+        }
+
+        void    Flush()
+        {
+            if (owner != nullptr && !entries.empty())
+            {
+                owner->Merge(entries);
+            }
+        }
+    };
+
+    ConcurrentAppender(const ConcurrentAppender&) = delete;
+    ConcurrentAppender& operator=(const ConcurrentAppender&) = delete;
+
+    ConcurrentAppender(GroupBase &group, bool ordered = false)
+        : group(group),
+          ordered(ordered)
+    {}
+
+    template<typename T>
+    ConcurrentAppender& Append(const T &object, uint64_t key = 0)
+    /// Appends a single element under the lock, prefer a Local per producer.
+    {
+        auto    shared = std::make_shared<T>(object);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.push_back({key, std::move(shared)});
+        return *this;
+    }
+
+    GroupBase&  Commit()
+    /// Appends the collected elements to the group. Call once all producers
+    /// have finished and their Local buffers are flushed.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (ordered)
+        {
+            std::stable_sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b){return a.key < b.key;});
+        }
+        for (auto &entry : entries)
+        {
+            group.AppendShared(std::move(entry.object));
+        }
+        entries.clear();
+
+        return group;
+    }
+};
+
+//-----------------------------------------------------------------------------
+class ChunkedWriter
+{
+    // Pull based serialization of an element tree. Every call to Next()
+    // returns the following chunk of at most chunk_size bytes, resuming where
+    // the previous call stopped, so serialization can be interleaved with
+    // other work. The element must outlive the writer and stay unchanged.
+    struct Frame
+    {
+        const Base                          *element;
+        size_t                              step;
+        std::unique_ptr<Base::StepState>    state;
+    };
+
+    std::vector<Frame>  frames;
+    std::string         pending;
+    size_t              offset{0};      ///< of the output not returned yet in pending.
+    size_t              chunk_size;
+
+public:
+    ChunkedWriter(const Base &root, size_t chunk_size = 64 * 1024)
+        : chunk_size(std::max<size_t>(chunk_size, 1))
+    {
+        frames.push_back({&root, 0, nullptr});
+    }
+
+    bool    Done() const {return frames.empty() && offset == pending.size();}
+
+    bool    Next(std::string &chunk)
+    /// Replaces chunk by the next piece of output. Returns false, with chunk
+    /// empty, when all has been written.
+    {
+        StringSink  sink(pending);
+        while (pending.size() - offset < chunk_size && !frames.empty())
+        {
+            const Base  *child{nullptr};
+            Frame       &frame = frames.back();
+            if (!frame.element->StatefulStep(sink, frame.step++, child, frame.state))
+            {
+                frames.pop_back();
+            }
+            if (child != nullptr)
+            {
+                frames.push_back({child, 0, nullptr});
+            }
+        }
+
+        // a step may write far more than a chunk, which is then returned
+        // from the offset on, moving the rest only once half is returned.
+        const size_t    size = std::min(chunk_size, pending.size() - offset);
+        chunk.assign(pending, offset, size);
+        offset += size;
+        if (offset * 2 >= pending.size())
+        {
+            pending.erase(0, offset);
+            offset = 0;
+        }
+
+        return !chunk.empty();
     }
 };
 
@@ -0,0 +1,895 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include "simple_svg_writer.h"
+#include "simple_svg_batch.h"
+#include "simple_svg_reader.h"
+#include "simple_svg_density.h"
+#include "simple_svg_binary.h"
+#include "simple_svg_animation.h"
+#include "simple_svg_raster.h"
+#include "simple_svg_template.h"
+
+// Checks of the library, run by ctest. Every Test...() function checks one
+// feature and reports mismatches through Check().
+
+static int  failures{0};
+
+static void Check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static simple_svg::Document Sample()
+/// A document with an element of every kind, large enough to take many chunks.
+{
+    simple_svg::Document    d(200, 200);
+    d.ViewBox(0, 0, 200, 200);
+
+    simple_svg::Group   g;
+    g.Fill("none").Stroke("black");
+    for (int i = 0; i < 50; ++i)
+    {
+        simple_svg::Circle  c(i * 4.0, 100.0 + i * 0.125, 3.5);
+        c.Fill("red").Id("c" + std::to_string(i));
+        g.Append(c);
+    }
+    simple_svg::Polyline    pl;
+    for (int i = 0; i < 3000; ++i)
+    {
+        pl.Add(i * 0.0625, (i % 17) * 1.5);
+    }
+    g.Append(pl);
+    simple_svg::Path    p;
+    for (int i = 0; i < 3000; ++i)
+    {
+        p.Command(i == 0 ? 'M' : 'l', {1.25, (i % 3) - 1.0});
+    }
+    p.Command('Z', {});
+    g.Append(p);
+    d.Append(g);
+    d.Append(simple_svg::Text(10, 20, "a < b & \"c\""));
+    d.Append(simple_svg::Rect(1, 2, 3, 4));
+    d.Append(simple_svg::Line(1, 2, 3, 4));
+    d.Append(simple_svg::Ellipse(1, 2, 3, 4));
+    return d;
+}
+
+static void TestSinks()
+{
+    const simple_svg::Document  d = Sample();
+    const std::string           text = d.ToText();
+
+    Check(d.TextSize() == text.size(), "TextSize() equals the size of ToText()");
+
+    std::string buffer(text.size(), '\0');
+    simple_svg::BufferSink  sink(&buffer[0], buffer.size());
+    d.Serialize(sink);
+    Check(sink.Size() == text.size() && buffer == text, "BufferSink output equals ToText()");
+
+    std::ostringstream  stream;
+    stream << d;
+    Check(stream.str() == text, "stream output equals ToText()");
+}
+
+static void TestToText()
+{
+    // subclasses of the string based interface of old.
+    struct Legacy : simple_svg::Base
+    {
+        Legacy() : simple_svg::Base("legacy") {}
+        virtual std::string ToText() const override {return "<legacy/>";}
+    };
+    const Legacy            legacy;
+    const simple_svg::Base  &base = legacy;
+    Check(base.ToText() == "<legacy/>", "ToText() is overridden through Base");
+}
+
+static void TestChunkedWriter()
+{
+    const simple_svg::Document  d = Sample();
+    const std::string           text = d.ToText();
+    for (size_t chunk_size : {1, 7, 100, 4096, 1 << 20})
+    {
+        simple_svg::ChunkedWriter   writer(d, chunk_size);
+        std::string                 joined;
+        std::string                 chunk;
+        bool                        bounded{true};
+        while (writer.Next(chunk))
+        {
+            bounded = bounded && chunk.size() <= chunk_size;
+            joined += chunk;
+        }
+        Check(joined == text, "ChunkedWriter output equals ToText()");
+        Check(bounded, "ChunkedWriter chunks are at most chunk_size");
+        Check(writer.Done(), "ChunkedWriter is done after the last chunk");
+    }
+}
+
+static std::string  EscapedScalar(const std::string &text)
+{
+    std::string escaped;
+    for (const char c : text)
+    {
+        switch (c)
+        {
+        case '&':   escaped += "&amp;";     break;
+        case '<':   escaped += "&lt;";      break;
+        case '>':   escaped += "&gt;";      break;
+        case '"':   escaped += "&quot;";    break;
+        default:    escaped += c;           break;
+        }
+    }
+    return escaped;
+}
+
+static void TestEscaping()
+{
+    // every position in and around the 16 and 32 byte blocks of the vector
+    // scans, and the scalar tail.
+    for (size_t size = 0; size <= 100; ++size)
+    {
+        for (size_t position = 0; position <= size; ++position)
+        {
+            for (const char special : {'&', '<', '>', '"'})
+            {
+                std::string text(size, 'a');
+                if (position < size)
+                {
+                    text[position] = special;
+                }
+                const size_t    expected = position < size ? position : size;
+                if (simple_svg::escape_scan(text.data(), text.size()) != expected)
+                {
+                    Check(false, "escape_scan finds the first special character");
+                    return;
+                }
+
+                std::string         written;
+                simple_svg::StringSink  sink(written);
+                sink.WriteEscaped(text + "x>" + text);
+                if (written != EscapedScalar(text + "x>" + text))
+                {
+                    Check(false, "WriteEscaped matches scalar escaping");
+                    return;
+                }
+            }
+        }
+    }
+
+    const simple_svg::Text  text(0, 0, "<b>&amp;\"quoted\"</b>");
+    Check(text.ToText().find("&lt;b&gt;&amp;amp;&quot;quoted&quot;&lt;/b&gt;") != std::string::npos, "Text content is escaped");
+    simple_svg::Rect    rect(1, 2, 3, 4);
+    rect.AddAttribute({"data-x", std::string("a\"b&c")});
+    Check(rect.ToText().find("data-x=\"a&quot;b&amp;c\"") != std::string::npos, "attribute values are escaped");
+}
+
+static void TestBase64()
+{
+    static const char   digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (size_t size = 0; size <= 100; ++size)
+    {
+        std::vector<uint8_t>    data(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            data[i] = static_cast<uint8_t>(i * 37 + 11);
+        }
+
+        std::string expected;
+        for (size_t i = 0; i < size; i += 3)
+        {
+            const uint32_t  bits = (uint32_t(data[i]) << 16) | (i + 1 < size ? uint32_t(data[i + 1]) << 8 : 0) | (i + 2 < size ? data[i + 2] : 0);
+            expected += digits[(bits >> 18) & 63];
+            expected += digits[(bits >> 12) & 63];
+            expected += i + 1 < size ? digits[(bits >> 6) & 63] : '=';
+            expected += i + 2 < size ? digits[bits & 63] : '=';
+        }
+
+        std::string encoded(simple_svg::base64_size(size), '\0');
+        encoded.resize(simple_svg::base64_encode(data.data(), size, &encoded[0]));
+        if (encoded != expected)
+        {
+            Check(false, "base64_encode matches the scalar reference");
+            return;
+        }
+    }
+}
+
+static void TestImage()
+{
+    simple_svg::Image   small(0, 0, 1, 1);
+    small.Data(std::vector<uint8_t>{'M', 'a', 'n'}, "image/png");
+    Check(small.ToText() == "<image xlink:href=\"data:image/png;base64,TWFu\" x=\"0\" y=\"0\" width=\"1\" height=\"1\"/>", "Image embeds a buffer as a data URI");
+
+    // data of several steps, embedded from a buffer and from a file.
+    std::vector<uint8_t>    data(100001);
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = static_cast<uint8_t>(i * 131 + i / 977);
+    }
+    const auto  path = std::filesystem::temp_directory_path() / "simple_svg_tests_image.png";
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+    simple_svg::Image   buffer(0, 0, 1, 1);
+    buffer.Data(data.data(), data.size(), "image/png");
+    simple_svg::Image   file(0, 0, 1, 1);
+    file.File(path.string());
+    std::string encoded(simple_svg::base64_size(data.size()), '\0');
+    encoded.resize(simple_svg::base64_encode(data.data(), data.size(), &encoded[0]));
+    const std::string   expected = "<image xlink:href=\"data:image/png;base64," + encoded + "\" x=\"0\" y=\"0\" width=\"1\" height=\"1\"/>";
+    Check(buffer.ToText() == expected && file.ToText() == expected, "Image embeds buffers and files as data URIs");
+    Check(file.TextSize() == expected.size(), "Image counts embedded files without reading them");
+
+    std::string                 chunked;
+    std::string                 chunk;
+    simple_svg::ChunkedWriter   writer(file, 4096);
+    while (writer.Next(chunk))
+    {
+        chunked += chunk;
+    }
+    Check(chunked == expected, "Image writes embedded files in steps");
+    std::filesystem::remove(path);
+}
+
+static void TestConcurrentAppender()
+{
+    // producers appending interleaved keys, each a run of its own.
+    constexpr int       producers = 4;
+    constexpr int       count = 1000;
+    simple_svg::Group   ordered;
+    simple_svg::Group   unordered;
+    {
+        simple_svg::ConcurrentAppender  sorting(ordered, true);
+        simple_svg::ConcurrentAppender  appending(unordered);
+        std::vector<std::thread>        threads;
+        for (int t = 0; t < producers; ++t)
+        {
+            threads.emplace_back([&sorting, &appending, t]()
+            {
+                simple_svg::ConcurrentAppender::Local   local(sorting);
+                simple_svg::ConcurrentAppender::Local   run(appending);
+                for (int i = 0; i < count; ++i)
+                {
+                    const int   key = i * producers + t;
+                    local.Append(simple_svg::Circle(key, t, 1), static_cast<uint64_t>(key));
+                    run.Append(simple_svg::Circle(i, t, 1));
+                }
+            });
+        }
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        sorting.Commit();
+        appending.Commit();
+    }
+
+    bool    sorted = ordered.Objects().size() == static_cast<size_t>(producers * count);
+    for (size_t i = 0; sorted && i < ordered.Objects().size(); ++i)
+    {
+        sorted = ordered.Objects()[i]->NumericAttribute("cx") == static_cast<double>(i);
+    }
+    Check(sorted, "ConcurrentAppender appends all elements in key order");
+
+    bool    runs = unordered.Objects().size() == static_cast<size_t>(producers * count);
+    for (size_t i = 0; runs && i < unordered.Objects().size(); ++i)
+    {
+        const auto  &object = *unordered.Objects()[i];
+        const auto  &first = *unordered.Objects()[i - i % count];
+        runs = object.NumericAttribute("cx") == static_cast<double>(i % count) && object.NumericAttribute("cy") == first.NumericAttribute("cy");
+    }
+    Check(runs, "ConcurrentAppender appends the buffer of every producer in one piece");
+}
+
+static void TestBatchRenderer()
+{
+    const auto  directory = std::filesystem::temp_directory_path() / "simple_svg_tests";
+    std::filesystem::create_directories(directory);
+
+    auto    draw = [](simple_svg::Document &d, int i)
+    {
+        d.Size(100, 100);
+        for (int k = 0; k <= i; ++k)
+        {
+            d.Append(simple_svg::Circle(k, i, 2.5));
+        }
+    };
+    simple_svg::BatchRenderer   renderer(4, 2);
+    for (int i = 0; i < 40; ++i)
+    {
+        renderer.Add((directory / (std::to_string(i) + ".svg")).string(), [i, &draw](simple_svg::Document &d){draw(d, i);});
+    }
+    renderer.Run();
+
+    bool    equal{true};
+    for (int i = 0; i < 40; ++i)
+    {
+        simple_svg::Document    d;
+        draw(d, i);
+        std::ifstream       file(directory / (std::to_string(i) + ".svg"), std::ios::binary);
+        std::ostringstream  text;
+        text << file.rdbuf();
+        equal = equal && text.str() == d.ToText();
+    }
+    Check(equal, "BatchRenderer files equal ToText() of their documents");
+    std::filesystem::remove_all(directory);
+}
+
+static void TestReader()
+{
+    const std::string   text =
+        "<svg width=\"100\" height=\"100\" xmlns=\"http://www.w3.org/2000/svg\">"
+        "<g transform=\"translate(123456.789 0.5)\" fill=\"red\">"
+        "<polyline points=\"1234567.25,1 0.1,0.2 1e-7,3\"/>"
+        "<path d=\"M 1234.5678 1 L 2 3.000001 a 5 5 0 1 0 10 10 z\"/>"
+        "<circle cx=\"123456.789\" cy=\"1\" r=\"50%\"/>"
+        "<text x=\"1\" y=\"2\">a &lt; b</text>"
+        "</g></svg>";
+    const simple_svg::Document  d = simple_svg::Reader(text).Read();
+    const std::string           written = d.ToText();
+
+    Check(written.find("translate(123456.789 0.5)") != std::string::npos, "Reader keeps transforms as written");
+    Check(written.find("points=\"1234567.25,1 0.1,0.2 1e-07,3 \"") != std::string::npos, "Reader keeps the digits of points");
+    Check(written.find("d=\"M 1234.5678 1 L 2 3.000001 a 5 5 0 1 0 10 10 z\"") != std::string::npos, "Reader keeps the digits of paths");
+    Check(written.find("cx=\"123456.789\"") != std::string::npos && written.find("r=\"50%\"") != std::string::npos, "Reader keeps attribute values");
+    Check(written.find(">a &lt; b</text>") != std::string::npos, "Reader keeps text content");
+    Check(simple_svg::Reader(written).Read().ToText() == written, "reading the written document writes the same");
+
+    const simple_svg::Document  sample = Sample();
+    const std::string           sample_text = sample.ToText();
+    Check(simple_svg::Reader(sample_text).Read().ToText() == sample_text, "Reader reads written documents back unchanged");
+
+    std::string nested("<svg>");
+    for (int i = 0; i < 200000; ++i)
+    {
+        nested += "<g>";
+    }
+    std::string message;
+    try
+    {
+        simple_svg::Reader(nested).Read();
+    }
+    catch (const std::runtime_error &error)
+    {
+        message = error.what();
+    }
+    Check(message.find("too deep") != std::string::npos, "Reader limits the nesting it reads");
+}
+
+static void TestDensityMap()
+{
+    // chunks large enough for several threads, which reuse their grids.
+    const size_t        count = 600000;
+    std::vector<double> x(count);
+    std::vector<double> y(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        x[i] = static_cast<double>((i * 7919) % 1000) / 100.0;
+        y[i] = static_cast<double>((i * 104729) % 1000) / 100.0;
+    }
+
+    simple_svg::DensityMap  whole(0, 0, 10, 10, 10, 10);
+    whole.Threads(1).Add(x, y);
+    simple_svg::DensityMap  chunked(0, 0, 10, 10, 10, 10);
+    chunked.Threads(4);
+    for (size_t first = 0; first < count; first += 150000)
+    {
+        chunked.Add(x.data() + first, y.data() + first, std::min<size_t>(150000, count - first));
+    }
+
+    bool    equal{true};
+    double  sum{0.0};
+    for (size_t row = 0; row < 10; ++row)
+    {
+        for (size_t column = 0; column < 10; ++column)
+        {
+            equal = equal && whole.Total(column, row) == chunked.Total(column, row);
+            sum += chunked.Total(column, row);
+        }
+    }
+    Check(equal && sum == static_cast<double>(count), "DensityMap totals do not depend on chunks and threads");
+}
+
+static void TestBinary()
+{
+    simple_svg::Document    d = Sample();
+    simple_svg::LevelOfDetail   detail;
+    detail.Level(0.0, simple_svg::Rect(0, 0, 10, 10)).Level(2.0, simple_svg::Circle(5, 5, 5));
+    detail.Responsive(200);
+    d.Append(detail);
+    simple_svg::CircleBatch circles(2.0);
+    circles.Add(1, 2).Add(3, 4, 5);
+    d.Append(circles);
+    simple_svg::RectBatch   rects(2.0, 3.0);
+    rects.Add(1, 2);
+    d.Append(rects);
+    d.Append(simple_svg::Slot("body"));
+
+    const std::string   binary = simple_svg::Binary::ToBinary(d);
+    const auto          root = simple_svg::Binary::Read(binary);
+    Check(root->ToText() == d.ToText(), "Binary reads back what it wrote");
+    const auto  &objects = static_cast<const simple_svg::GroupBase&>(*root).Objects();
+    bool        classes = objects.size() >= 4;
+    for (size_t i = 0; classes && i < 4; ++i)
+    {
+        const auto  &read = *objects[objects.size() - 4 + i];
+        const auto  &original = *d.Objects()[d.Objects().size() - 4 + i];
+        classes = typeid(read) == typeid(original);
+    }
+    Check(classes, "Binary reads back the classes written");
+
+    const simple_svg::Document  parsed = simple_svg::Reader(Sample().ToText()).Read();
+    Check(simple_svg::Binary::Read(simple_svg::Binary::ToBinary(parsed))->ToText() == parsed.ToText(), "Binary keeps documents read from text");
+
+    size_t  rejected{0};
+    for (size_t size = 0; size < binary.size(); size += 97)
+    {
+        try
+        {
+            simple_svg::Binary::Read(std::string_view(binary.data(), size));
+        }
+        catch (const std::runtime_error&)
+        {
+            ++rejected;
+        }
+    }
+    Check(rejected == (binary.size() + 96) / 97, "Binary rejects truncated data");
+
+    struct Custom : simple_svg::Base
+    {
+        Custom() : simple_svg::Base("custom") {}
+    };
+    bool    thrown{false};
+    try
+    {
+        simple_svg::Binary::ToBinary(Custom());
+    }
+    catch (const std::invalid_argument&)
+    {
+        thrown = true;
+    }
+    Check(thrown, "Binary refuses classes it cannot read back");
+
+    // groups nested deeper than any file written, each with one child.
+    std::string nested("SSVG", 4);
+    const uint32_t  header[5] = {2, 0x01020304, 1, 0, 0};
+    nested.append(reinterpret_cast<const char*>(header), sizeof(header) - sizeof(uint32_t));
+    for (int i = 0; i < 100000; ++i)
+    {
+        const char      kind = 14;
+        const uint32_t  tag_and_attributes[2] = {0, 0};
+        const uint64_t  children = 1;
+        nested.append(&kind, 1);
+        nested.append(reinterpret_cast<const char*>(tag_and_attributes), sizeof(tag_and_attributes));
+        nested.append(reinterpret_cast<const char*>(&children), sizeof(children));
+    }
+    std::string message;
+    try
+    {
+        simple_svg::Binary::Read(nested);
+    }
+    catch (const std::runtime_error &error)
+    {
+        message = error.what();
+    }
+    Check(message.find("too deep") != std::string::npos, "Binary limits the nesting it reads");
+}
+
+static std::string LastValue(const std::string &text, const std::string &type)
+/// The value of the last frame of the <animateTransform> of type in text.
+{
+    const size_t    start = text.find("values=\"", text.find("type=\"" + type + "\""));
+    const size_t    end = text.find('"', start + 8);
+    const size_t    last = text.rfind(';', end);
+    return text.substr(std::max(start + 8, last + 1), end - std::max(start + 8, last + 1));
+}
+
+static void TestAnimation()
+{
+    simple_svg::Document    first(100, 100);
+    simple_svg::Circle      ball(10, 10, 5);
+    ball.Id("ball");
+    first.Append(ball);
+    simple_svg::Document    second(100, 100);
+    ball.AddAttribute({"cx", 20.0});
+    ball.Transform(simple_svg::Transform().Scale(2, 3).Rotate(90).Translate(5, 6));
+    second.Append(ball);
+
+    simple_svg::Animation   animation(0.5);
+    animation.AddFrame(first).AddFrame(second);
+    const std::string   text = animation.Compile().ToText();
+    Check(text.find(
+        "  <circle  cx=\"10\" cy=\"10\" r=\"5\" id=\"ball\"/>\n"
+        "  <animate  xlink:href=\"#ball\" attributeName=\"cx\" calcMode=\"discrete\" values=\"10;20\" keyTimes=\"0;0.5\" dur=\"1s\" repeatCount=\"indefinite\"/>\n"
+        "  <animateTransform  xlink:href=\"#ball\" attributeName=\"transform\" type=\"translate\" calcMode=\"discrete\" values=\"0 0;5 6\" keyTimes=\"0;0.5\" dur=\"1s\" repeatCount=\"indefinite\"/>\n"
+        "  <animateTransform  xlink:href=\"#ball\" attributeName=\"transform\" type=\"rotate\" additive=\"sum\" calcMode=\"discrete\" values=\"0;90\" keyTimes=\"0;0.5\" dur=\"1s\" repeatCount=\"indefinite\"/>\n"
+        "  <animateTransform  xlink:href=\"#ball\" attributeName=\"transform\" type=\"scale\" additive=\"sum\" calcMode=\"discrete\" values=\"1 1;2 3\" keyTimes=\"0;0.5\" dur=\"1s\" repeatCount=\"indefinite\"/>\n"
+        "</svg>") != std::string::npos, "Animation of two frames");
+
+    // any invertible transform, put back together from its parts.
+    const simple_svg::Transform skewed(1.5, -0.5, 0.75, 2.0, 3.0, 4.0);
+    simple_svg::Document        third(100, 100);
+    ball.Transform(skewed);
+    third.Append(ball);
+    const std::string   parts = simple_svg::Animation().AddFrame(first).AddFrame(third).Compile().ToText();
+    double  tx{0}, ty{0}, angle{0}, sx{0}, sy{0}, skew{0};
+    std::sscanf(LastValue(parts, "translate").c_str(), "%lf %lf", &tx, &ty);
+    std::sscanf(LastValue(parts, "rotate").c_str(), "%lf", &angle);
+    std::sscanf(LastValue(parts, "scale").c_str(), "%lf %lf", &sx, &sy);
+    std::sscanf(LastValue(parts, "skewX").c_str(), "%lf", &skew);
+    const simple_svg::Transform combined = simple_svg::Transform().SkewX(skew).Scale(sx, sy).Rotate(angle).Translate(tx, ty);
+    const double    difference = std::fabs(combined.A() - skewed.A()) + std::fabs(combined.B() - skewed.B()) + std::fabs(combined.C() - skewed.C())
+                                 + std::fabs(combined.D() - skewed.D()) + std::fabs(combined.E() - skewed.E()) + std::fabs(combined.F() - skewed.F());
+    Check(difference < 1e-3, "Animation splits transforms into parts giving the transform");
+
+    bool    thrown{false};
+    ball.Transform(simple_svg::Transform(0, 0, 1, 1, 0, 0));
+    simple_svg::Document    collapsed(100, 100);
+    collapsed.Append(ball);
+    try
+    {
+        simple_svg::Animation().AddFrame(first).AddFrame(collapsed).Compile();
+    }
+    catch (const std::invalid_argument&)
+    {
+        thrown = true;
+    }
+    Check(thrown, "Animation refuses transforms it cannot split");
+
+    // a group of two tracked elements appearing in the second frame.
+    simple_svg::Document    later(first);
+    simple_svg::Group       group;
+    group.Id("a").Transform(simple_svg::Transform().Translate(1, 2));
+    group.Append(simple_svg::Circle(1, 2, 3).Id("b"));
+    later.Append(group);
+    const std::string   appended = simple_svg::Animation().AddFrame(first).AddFrame(later).Compile().ToText();
+    Check(appended.find("id=\"a-shown\"") != std::string::npos && appended.find("id=\"b-shown\"") == std::string::npos
+          && appended.find("id=\"b\"") == appended.rfind("id=\"b\""), "Animation appends elements appearing later once");
+    Check(appended.find("xlink:href=\"#b\" attributeName=\"display\"") == std::string::npos, "Animation shows elements appearing later with their group");
+}
+
+static void TestFixedElements()
+{
+    simple_svg::FixedCircle     fixed_circle(1, 2, 3);
+    simple_svg::Circle          circle(1, 2, 3);
+    simple_svg::FixedEllipse    fixed_ellipse(1, 2, 3, 4);
+    simple_svg::Ellipse         ellipse(1, 2, 3, 4);
+    simple_svg::FixedLine       fixed_line(1, 2, 3, 4);
+    simple_svg::Line            line(1, 2, 3, 4);
+    simple_svg::FixedRect       fixed_rect(1, 2, 3, 4);
+    simple_svg::Rect            rect(1, 2, 3, 4);
+    const std::pair<simple_svg::Base*, simple_svg::Base*>   pairs[] = {{&fixed_circle, &circle}, {&fixed_ellipse, &ellipse}, {&fixed_line, &line}, {&fixed_rect, &rect}};
+
+    bool    equal{true};
+    for (const auto &pair : pairs)
+    {
+        equal = equal && pair.first->ToText() == pair.second->ToText();
+        for (simple_svg::Base *element : {pair.first, pair.second})
+        {
+            // geometry and other attributes through the base class.
+            element->Fill("red").AddAttribute({"cx", 7.5}).AddAttribute({"x2", -0.125}).AddAttribute({"width", 1e-7});
+            element->AddAttribute({"id", std::string("a")}).AddAttribute({"id", std::string("b")});
+            element->ApplyTransform(simple_svg::Transform().Translate(0.5, 1.0));
+        }
+        equal = equal && pair.first->ToText() == pair.second->ToText();
+    }
+    Check(equal, "fixed elements write the same as the elements of their schema");
+    const std::string   written = fixed_circle.ToText();
+    Check(written.find(" cx=\"8\"") != std::string::npos && written.find(" cx=") == written.rfind(" cx="), "fixed elements write each attribute once");
+
+    bool    thrown{false};
+    try
+    {
+        static_cast<simple_svg::Base&>(fixed_circle).AddAttribute({"r", std::string("50%")});
+    }
+    catch (const std::invalid_argument&)
+    {
+        thrown = true;
+    }
+    Check(thrown && fixed_circle.Radius() == 3, "fixed elements reject geometry that is not a number");
+}
+
+static simple_svg::Document Drawing()
+/// Shapes with redundant geometry and runs of equal style, some overlapping.
+/// Strokes removed by Clean() lie on whole pixels, as the rasterizer adds up
+/// the coverage of a join and its segments in pixels they cover partly.
+{
+    simple_svg::Document    d(100, 100);
+    d.ViewBox(0, 0, 100, 100);
+
+    simple_svg::Group   lines;
+    lines.Fill("none").Stroke("black").StrokeWidth(2);
+    for (int i = 0; i < 10; ++i)
+    {
+        lines.Append(simple_svg::Line(5, 5 + i * 4, 45, 8 + i * 4));
+    }
+    simple_svg::Polyline    polyline;
+    polyline.Add(5, 60).Add(5, 60).Add(15, 60).Add(25, 60).Add(25, 70).Add(25, 70.0001).Add(25, 80);
+    lines.Append(polyline);
+    d.Append(lines);
+
+    simple_svg::Group   shapes;
+    shapes.Fill("steelblue");
+    for (int i = 0; i < 5; ++i)
+    {
+        shapes.Append(simple_svg::Rect(55 + i * 8, 5, 6, 30));
+    }
+    shapes.Append(simple_svg::Rect(60, 20, 20, 20));        // overlaps the run
+    shapes.Append(simple_svg::Rect(60, 50, 0, 20));         // draws nothing
+    shapes.Append(simple_svg::Circle(80, 80, 0));
+    simple_svg::Polygon polygon;
+    polygon.Add(55, 90).Add(65, 60).Add(75, 90).Add(75, 90).Add(65, 90);
+    shapes.Append(polygon);
+    simple_svg::Path    path;
+    path.Command('M', {80, 50}).Command('l', {10, 0}).Command('l', {0, 0}).Command('l', {0, 10}).Command('Z', {});
+    shapes.Append(path);
+    d.Append(shapes);
+    d.Append(simple_svg::Rect(0, 95, 100, 5).Fill("red").Opacity(0.5));
+    d.Append(simple_svg::Rect(0, 97, 100, 5).Fill("red").Opacity(0.5));
+    return d;
+}
+
+static void TestCleanAndMerge()
+{
+    const auto  render = [](const simple_svg::Document &d){return simple_svg::Rasterizer(100).Render(d).Png();};
+    const auto  reference = render(Drawing());
+
+    simple_svg::Document    cleaned = Drawing();
+    const std::string       before = cleaned.ToText();
+    cleaned.Clean();
+    Check(cleaned.ToText().size() < before.size(), "Clean removes something of the drawing");
+    Check(render(cleaned) == reference, "Clean keeps the rendering");
+
+    simple_svg::Document    merged = Drawing();
+    merged.MergeShapes();
+    Check(merged.ToText().size() < before.size(), "MergeShapes merges something of the drawing");
+    Check(render(merged) == reference, "MergeShapes keeps the rendering");
+
+    simple_svg::Document    both = Drawing();
+    both.Clean().MergeShapes();
+    Check(render(both) == reference, "Clean and MergeShapes together keep the rendering");
+
+    simple_svg::Group   shapes;
+    simple_svg::Group   fixed;
+    shapes.Stroke("black").Fill("none");
+    fixed.Stroke("black").Fill("none");
+    for (int i = 0; i < 3; ++i)
+    {
+        shapes.Append(simple_svg::Rect(i * 10, 0, 5, 5)).Append(simple_svg::Line(0, i, 10, i));
+        fixed.Append(simple_svg::FixedRect(i * 10, 0, 5, 5)).Append(simple_svg::FixedLine(0, i, 10, i));
+    }
+    shapes.MergeShapes();
+    fixed.MergeShapes();
+    Check(fixed.Objects().size() == 1 && fixed.ToText() == shapes.ToText(), "MergeShapes merges FixedRect and FixedLine like Rect and Line");
+}
+
+static void TestRasterizer()
+{
+    simple_svg::Document    square(100, 100);
+    square.Append(simple_svg::Rect(0, 0, 100, 100).Fill("black"));
+    simple_svg::Document    wide(100, 50);
+    wide.Append(simple_svg::Rect(0, 0, 100, 50).Fill("black"));
+
+    simple_svg::Rasterizer  rasterizer(100);
+    rasterizer.Render(square);
+    Check(rasterizer.Height() == 100, "Rasterizer follows the aspect ratio of the document");
+    rasterizer.Render(wide);
+    Check(rasterizer.Height() == 50 && rasterizer.Pixels().size() == 100 * 50 * 4 && rasterizer.Pixels()[3] == 255,
+          "Rasterizer follows the aspect ratio of every document rendered");
+    Check(simple_svg::Rasterizer(100, 100).Render(wide).Height() == 100, "Rasterizer keeps a given height");
+}
+
+static void TestTemplate()
+{
+    simple_svg::Document    d(100, 100);
+    simple_svg::Text        label(10, 20, simple_svg::Template::Placeholder("label"));
+    label.Fill(simple_svg::Template::Placeholder("colour"));
+    d.Append(label);
+    d.Append(simple_svg::Text(10, 40, simple_svg::Template::Placeholder("markup")).Escape(false));
+    d.Append(simple_svg::Slot("body"));
+    d.Append(simple_svg::Text(10, 60, simple_svg::Template::Placeholder("label")));
+
+    const simple_svg::Template      badge(d);
+    std::vector<std::string_view>   values(badge.Holes());
+    Check(badge.Holes() == 4, "Template counts every placeholder once");
+    values[badge.Index("label")] = "a < b";
+    values[badge.Index("colour")] = "red";
+    values[badge.Index("markup")] = "<tspan>x</tspan>";
+    values[badge.Index("body")] = "<circle r=\"1\"/>";
+
+    std::string filled;
+    badge.Fill(filled, values);
+    const std::string   text = d.ToText();
+    const std::string   expected = text.substr(0, text.find("  <text")) +
+        "  <text x=\"10\" y=\"20\" fill=\"red\">a &lt; b</text>\n"
+        "  <text x=\"10\" y=\"40\"><tspan>x</tspan></text>\n"
+        "  <circle r=\"1\"/>\n"
+        "  <text x=\"10\" y=\"60\">a &lt; b</text>\n"
+        "</svg>";
+    Check(filled == expected, "Template fills holes, escaped unless written unescaped");
+}
+
+static void TestStorage()
+{
+    const auto  points = [](simple_svg::Storage storage)
+    {
+        simple_svg::Polyline    polyline;
+        polyline.StoreAs(storage, 2);
+        polyline.Add(1.23456, -0.005).Add(100000.125, 0.1).Add(1.0 / 3.0, 2.675);
+        return polyline.ToText();
+    };
+    const auto  path = [](simple_svg::Storage storage)
+    {
+        simple_svg::Path    path;
+        path.StoreAs(storage, 1);
+        path.Command('M', {1.25, 0.04}).Command('l', {-2.35, 1e-3}).Command('Z', {});
+        return path.ToText();
+    };
+
+    Check(points(simple_svg::Storage::Double) == "<polyline points=\"1.23456,-0.005 100000,0.1 0.333333,2.675 \"/>", "Storage::Double writes 6 significant digits");
+    Check(points(simple_svg::Storage::Float) == "<polyline points=\"1.23456,-0.005 100000.125,0.1 0.33333334,2.675 \"/>", "Storage::Float writes the digits of the float");
+    Check(points(simple_svg::Storage::Fixed) == "<polyline points=\"1.23,-0.01 100000.13,0.1 0.33,2.68 \"/>", "Storage::Fixed rounds to its decimals, halves away from zero");
+    Check(path(simple_svg::Storage::Float) == "<path d=\"M 1.25 0.04 l -2.35 0.001 Z\"/>", "Storage::Float writes path data");
+    Check(path(simple_svg::Storage::Fixed) == "<path d=\"M 1.3 0 l -2.4 0 Z\"/>", "Storage::Fixed rounds path data, without negative zeros");
+
+    // converted after the points were added.
+    simple_svg::Polyline    converted;
+    converted.Add(1.23456, -0.005).Add(2.0 / 3.0, 7.0);
+    converted.StoreAs(simple_svg::Storage::Fixed, 1);
+    Check(converted.ToText() == "<polyline points=\"1.2,0 0.7,7 \"/>", "StoreAs() converts stored points");
+}
+
+static void TestMarkerBatch()
+{
+    simple_svg::CircleBatch circles(2);
+    circles.Add(10, 20).Add(30, 40, 5);
+    circles.Fill("red");
+    Check(circles.ToText() == "<path d=\"M 8 20 a 2 2 0 1 0 4 0 a 2 2 0 1 0 -4 0 z M 25 40 a 5 5 0 1 0 10 0 a 5 5 0 1 0 -10 0 z\" fill=\"red\"/>",
+          "MarkerBatch writes a subpath per copy");
+
+    simple_svg::RectBatch   rects(2, 3);
+    rects.Add(1, 2);
+    rects.UseMarker("box");
+    Check(rects.ToText() == "<g>\n  <defs><path id=\"box\" d=\"M 0 0 h 2 v 3 h -2 z\"/></defs>\n  <use xlink:href=\"#box\" x=\"1\" y=\"2\"/>\n</g>",
+          "MarkerBatch with UseMarker() writes a <use> per copy");
+    rects.Add(5, 6, 4, 6);
+    Check(rects.ToText() == "<g>\n  <defs><path id=\"box\" d=\"M 0 0 h 1 v 1 h -1 z\" vector-effect=\"non-scaling-stroke\"/></defs>\n"
+                            "  <use xlink:href=\"#box\" transform=\"translate(1 2) scale(2 3)\"/>\n"
+                            "  <use xlink:href=\"#box\" transform=\"translate(5 6) scale(4 6)\"/>\n</g>",
+          "MarkerBatch with UseMarker() scales copies of their own size");
+}
+
+static void TestFootprint()
+{
+    simple_svg::Document    d = Sample();
+    const auto              before = d.MeasureTree();
+    Check(before.count("circle") != 0 && before.at("circle").elements == 50 && before.at("polyline").coordinates >= 3000 * 2 * sizeof(double),
+          "MeasureTree() counts elements and coordinates by tag");
+
+    simple_svg::Polyline    extra;
+    for (int i = 0; i < 1000; ++i)
+    {
+        extra.Add(i, i);
+    }
+    d.Append(extra);
+    const auto  grown = d.MeasureTree();
+    Check(grown.at("polyline").elements == 2 && grown.at("polyline").coordinates > before.at("polyline").coordinates,
+          "MeasureTree() follows added elements");
+
+    const auto  shared = std::make_shared<simple_svg::Circle>(1, 2, 3);
+    simple_svg::Group   twice;
+    twice.AppendShared(shared).AppendShared(shared);
+    Check(twice.MeasureTree().at("circle").elements == 1, "MeasureTree() counts shared elements once");
+
+    const std::string   text = d.ToText();
+    const size_t        total = d.MeasureTotal().Total();
+    d.ShrinkToFit();
+    Check(d.MeasureTotal().Total() < total, "ShrinkToFit() releases unused capacity");
+    Check(d.ToText() == text, "ShrinkToFit() keeps the output");
+}
+
+static void TestLevelOfDetail()
+{
+    simple_svg::Document        d(200, 100);
+    d.ViewBox(0, 0, 200, 100);
+    simple_svg::LevelOfDetail   detail;
+    detail.Level(0.0, simple_svg::Rect(0, 0, 1, 1)).Level(0.5, simple_svg::Circle(1, 1, 1)).Level(4.0, simple_svg::Line(0, 0, 1, 1));
+    d.Append(detail);
+
+    auto    writes = [&d](const char *tag, const char *others[2])
+    {
+        const std::string   text = d.ToText();
+        return text.find(tag) != std::string::npos
+            && text.find(others[0]) == std::string::npos && text.find(others[1]) == std::string::npos;
+    };
+    const char  *not_line[2] = {"<rect", "<circle"};
+    const char  *not_circle[2] = {"<rect", "<line"};
+    const char  *not_rect[2] = {"<circle", "<line"};
+    Check(writes("<line", not_line), "LevelOfDetail writes the most detailed level by default");
+    d.SelectDetail(0.1);
+    Check(writes("<rect", not_rect), "SelectDetail() picks the coarsest level below its scale");
+    d.SelectDetail(0.5);
+    Check(writes("<circle", not_circle), "SelectDetail() picks a level from its minimum scale");
+    d.SelectDetail(3.99);
+    Check(writes("<circle", not_circle), "SelectDetail() keeps a level up to the next one");
+    d.SelectDetail(10.0);
+    Check(writes("<line", not_line), "SelectDetail() picks the finest level above its scale");
+
+    d.ResponsiveDetail();
+    const std::string   text = d.ToText();
+    Check(text.find("<g class=\"lod-0-100\"><rect") != std::string::npos
+          && text.find("<g class=\"lod-100-800\"><circle") != std::string::npos
+          && text.find("<g class=\"lod-800-up\"><line") != std::string::npos,
+          "ResponsiveDetail() writes every level with its viewport width range");
+    Check(text.find("@media (max-width:99.99px){.lod-0-100{display:inline}}") != std::string::npos
+          && text.find("@media (min-width:100px) and (max-width:799.99px){.lod-100-800{display:inline}}") != std::string::npos
+          && text.find("@media (min-width:800px){.lod-800-up{display:inline}}") != std::string::npos,
+          "ResponsiveDetail() shows each level over its width range");
+    d.ResponsiveDetail();
+    Check(d.ToText() == text, "ResponsiveDetail() updates its style instead of adding one");
+}
+
+static void TestBakeTransforms()
+{
+    const auto  parsed = simple_svg::Transform::Parse("translate(10 20) rotate(90) scale(2, 3)");
+    Check(parsed.AsAttribute().Value() == "matrix(0 2 -3 0 10 20)", "Transform::Parse composes the functions in order");
+    Check(simple_svg::Transform().Translate(50, 50).AsAttribute().Value() == "translate(50 50)"
+          && simple_svg::Transform().Rotate(30).Translate(1, 2).AsAttribute().Value() == "translate(1 2) rotate(30)", "transforms write as the simplest functions");
+
+    simple_svg::Document    d(100, 100);
+    simple_svg::Group       g;
+    g.Transform(simple_svg::Transform().Translate(50, 50));
+    g.Append(simple_svg::Path().MoveTo({1, 2}, false).LineTo({3, 0}, false));
+    g.Append(simple_svg::Circle(1, 2, 3));
+    simple_svg::Group       inner;
+    inner.Transform(simple_svg::Transform().Scale(2));
+    inner.Append(simple_svg::Rect(1, 1, 2, 3));
+    g.Append(inner);
+    d.Append(g);
+    d.BakeTransforms();
+
+    const std::string   text = d.ToText();
+    Check(text.find("<path d=\"M 51 52 l 3 0\"/>") != std::string::npos, "BakeTransforms moves paths starting with a relative moveto");
+    Check(text.find("<circle  cx=\"51\" cy=\"52\" r=\"3\"/>") != std::string::npos, "BakeTransforms moves shapes");
+    Check(text.find("<rect  x=\"52\" y=\"52\" width=\"4\" height=\"6\"/>") != std::string::npos, "BakeTransforms applies nested transforms");
+    Check(text.find("transform") == std::string::npos, "BakeTransforms removes the transforms it applied");
+}
+
+int main()
+{
+    TestSinks();
+    TestToText();
+    TestChunkedWriter();
+    TestEscaping();
+    TestBase64();
+    TestImage();
+    TestConcurrentAppender();
+    TestBatchRenderer();
+    TestReader();
+    TestDensityMap();
+    TestBinary();
+    TestAnimation();
+    TestFixedElements();
+    TestCleanAndMerge();
+    TestBakeTransforms();
+    TestRasterizer();
+    TestTemplate();
+    TestStorage();
+    TestMarkerBatch();
+    TestFootprint();
+    TestLevelOfDetail();
+
+    if (failures != 0)
+    {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}